@@ -5,22 +5,300 @@
 #ifndef WEB_VIEW_H
 #define WEB_VIEW_H
 
+#include "core/list.h"
+#include "core/map.h"
+#include "core/set.h"
 #include "scene/gui/control.h"
 
+#include "webview_event_queue.h"
+#include "webview_pixels.h"
+#include "webview_pool.h"
+#include "webview_slot_map.h"
+
 /*************************************************************************/
 
 class WebViewOverlayImplementation;
+class WebViewSnapshotSource;
 class WebViewOverlay : public Control {
 	GDCLASS(WebViewOverlay, Control);
 
+public:
+	enum MessagePolicy {
+		MESSAGE_POLICY_IMMEDIATE, // Every message is emitted as it arrives.
+		MESSAGE_POLICY_LATEST, // Only the last message of the frame is emitted.
+		MESSAGE_POLICY_ACCUMULATE, // Numeric values of the frame messages are summed.
+		MESSAGE_POLICY_BATCH, // Messages of the frame are emitted together in an array.
+	};
+
+	enum InboundEventType {
+		INBOUND_MESSAGE,
+		INBOUND_START_NAVIGATION,
+		INBOUND_FINISH_NAVIGATION,
+		INBOUND_NEW_WINDOW,
+	};
+
+private:
+	enum ViewState {
+		VIEW_STATE_NONE, // View is not created, waiting for the host window.
+		VIEW_STATE_CREATING, // Backend is creating the view asynchronously.
+		VIEW_STATE_READY,
+		VIEW_STATE_FAILED,
+	};
+
+	enum CommandType {
+		COMMAND_LOAD_STRING,
+		COMMAND_EXEC_SCRIPT,
+		COMMAND_EVALUATE_SCRIPT,
+		COMMAND_CAPTURE,
+		COMMAND_LOAD_STREAM,
+	};
+
+	struct Command {
+		CommandType type;
+		String arg;
+		int width = 0;
+		uint64_t id = 0;
+	};
+
+	struct InboundEvent {
+		InboundEventType type = INBOUND_MESSAGE;
+		String payload;
+	};
+
+	struct ScriptMethod {
+		ObjectID target = 0;
+		StringName method;
+	};
+
+	struct ScriptCall {
+		uint64_t deadline = 0; // Ticks, or 0 without timeout.
+	};
+
+	struct SharedState {
+		Dictionary value; // State of the page mirror, once the pending operations are applied.
+		Variant source; // Last set_shared_state argument, diffed at the end of the frame.
+		bool source_pending = false;
+		bool full = true; // Whole state is sent with the next flush.
+		Map<String, Array> ops; // Pending operations by path, parents sort before children.
+	};
+
+	struct DocumentScript {
+		String name;
+		String source;
+	};
+
+	enum {
+		DOCUMENT_STREAM_BUDGET_USEC = 4000,
+	};
+
+	struct DocumentStream {
+		bool active = false;
+		bool started = false; // Sent to the backend, or waiting in the command queue.
+		bool ending = false; // Generator returned the end, backend is delivering the rest.
+		ObjectID target = 0;
+		StringName method;
+		int chunks = 0;
+		uint64_t bytes = 0;
+	};
+
+	struct ScriptEvaluation {
+		bool sent = false; // Sent to the backend, or waiting in the command queue.
+	};
+
+	enum {
+		MAX_BINARY_TRANSFER_SIZE = 256 * 1024 * 1024,
+	};
+
+	struct MessageChannel {
+		MessagePolicy policy = MESSAGE_POLICY_IMMEDIATE;
+		bool pending = false;
+		String latest; // Kept undecoded, only the emitted message is decoded.
+		Variant accumulated;
+		Array batch;
+	};
+
+	struct SnapshotRequest {
+		int width = 0;
+		bool stream = false;
+		int slot = -1;
+		// Cache key, if result should be stored in the snapshot cache.
+		bool cache = false;
+		String url;
+		Size2 viewport;
+		String fingerprint;
+		int tile = -1; // Full-page capture tile index.
+	};
+
+	struct SnapshotWaiting {
+		int width = 0;
+		int waiters = 1;
+	};
+
+	enum {
+		STREAM_RING_SIZE = 3,
+	};
+
+	enum FrameState {
+		FRAME_FREE,
+		FRAME_PENDING, // Capture is in flight.
+		FRAME_READY, // Captured, waiting for upload.
+	};
+
+	struct StreamFrame {
+		FrameState state = FRAME_FREE;
+		uint64_t seq = 0;
+		PoolVector<uint8_t> data; // Pixel buffer of the slot, owned by the image or the conversion job while in use.
+		Ref<Image> image;
+		Variant delta; // Changed rects relative to the previous converted frame, if detection is enabled.
+	};
+
+	enum {
+		FULL_PAGE_MAX_TILES = 256,
+		FULL_PAGE_TIMEOUT_MSEC = 10000,
+	};
+
+	struct FullPageCapture {
+		bool active = false;
+		bool tiled = false;
+		uint64_t seq = 0;
+		int width = 0;
+		int viewport_width = 0;
+		int viewport_height = 0;
+		int page_height = 0;
+		int scroll_y = 0;
+		int tile_count = 0;
+		int tiles_done = 0;
+		Vector<int> offsets; // Actual scroll position of each tile, differs from the expected one at the end of the page.
+		Ref<Image> image;
+		Array tiles;
+		uint64_t deadline = 0;
+	};
+
 	WebViewOverlayImplementation *data;
 
 	String home_url;
 	String user_agent;
 	double zoom = 1.0f;
 	bool no_background = false;
-	int ctrl_err_status = -1;
+	ViewState view_state = VIEW_STATE_NONE;
 	static int err_status;
+	static bool mock_backend;
+
+	// Backend events are queued by the platform callbacks (on any thread) and
+	// dispatched in the internal process, within the per-frame time budget.
+	WebViewEventQueue<InboundEvent> inbound_events;
+	std::atomic<bool> inbound_wake;
+	int event_budget_usec = 2000;
+	uint32_t inbound_max_depth = 0;
+	uint64_t inbound_dispatched = 0;
+	uint64_t inbound_deferred_frames = 0;
+	uint64_t inbound_last_drain = 0;
+
+	// Calls made before the view is ready, replayed in order once it is.
+	List<Command> pending_commands;
+
+	// Script batching, execute_java_script calls are concatenated and executed
+	// once per frame, or when the batch exceeds the size limit.
+	bool script_batching = false;
+	int script_batch_max_size = 65536;
+	String script_batch;
+	int script_batch_depth = 0;
+	uint64_t script_batch_started = 0;
+	uint64_t script_batch_flushes = 0;
+	uint64_t script_batch_scripts = 0;
+	uint64_t script_batch_last_flush = 0;
+	uint64_t script_batch_max_flush = 0;
+	uint64_t script_batch_last_latency = 0;
+
+	// Document-start scripts in registration order. Installed as one bundle, which
+	// is rebuilt only when the scripts change.
+	Vector<DocumentScript> document_scripts;
+	String document_script_bundle;
+
+	// Streamed document, chunks are pulled from the generator only as fast as the
+	// backend consumes them, within the per-frame time budget.
+	DocumentStream document_stream;
+	static uint64_t document_stream_seq;
+	uint64_t document_stream_max_chunk = 0;
+	uint64_t document_streams_finished = 0;
+	uint64_t document_streams_aborted = 0;
+
+	WebViewSlotMap<ScriptEvaluation> script_evaluations;
+	bool decode_messages = false;
+
+	// Script calls (RPC), outgoing calls and results are delivered once per frame.
+	Map<String, ScriptMethod> script_methods;
+	WebViewSlotMap<ScriptCall> script_calls;
+	double script_call_timeout = 30.0;
+	uint64_t rpc_next_deadline = 0;
+	Array rpc_outbox_calls;
+	Array rpc_outbox_results;
+	uint64_t rpc_calls_in = 0;
+	uint64_t rpc_calls_out = 0;
+	uint64_t rpc_batches_in = 0;
+	uint64_t rpc_batches_out = 0;
+	uint64_t rpc_timeouts = 0;
+
+	// Shared states, changes are sent as patch operations once per frame.
+	Map<String, SharedState> shared_states;
+	Set<String> removed_shared_states;
+	bool shared_states_dirty = false;
+	uint64_t shared_state_flushes = 0;
+	uint64_t shared_state_full_syncs = 0;
+	uint64_t shared_state_ops = 0;
+	uint64_t shared_state_bytes = 0;
+
+	// Binary channel, payloads of send_binary wait here until the page fetches them.
+	Map<uint32_t, PoolByteArray> binary_outbox;
+	uint32_t binary_send_seq = 0;
+
+	// Channel messages (webviewPost) are coalesced according to the channel policy
+	// and emitted once per frame, channels without a policy are emitted immediately.
+	Map<String, MessageChannel> message_channels;
+	int message_channels_pending = 0;
+	uint64_t channel_messages_received = 0;
+	uint64_t channel_messages_emitted = 0;
+
+	// Geometry changes are applied once per frame.
+	bool geometry_dirty = false;
+	Rect2 view_rect;
+	bool view_visible = false;
+
+	Map<uint64_t, SnapshotRequest> snapshot_requests;
+	uint64_t next_snapshot_id = 1;
+
+	// get_snapshot calls with the width of a pending capture are merged into it,
+	// captures above the in-flight limit wait in the queue (one per width).
+	int max_snapshots_in_flight = 2;
+	int snapshots_in_flight = 0;
+	List<SnapshotWaiting> snapshots_waiting;
+	uint64_t snapshots_merged = 0;
+	uint64_t snapshots_dropped = 0;
+	Ref<WebViewSnapshotPool> snapshot_pool;
+
+	bool snapshot_cache = false;
+	String snapshot_fingerprint;
+
+	// Frame streaming, captures are converted to the reusable ring buffers and
+	// only the most recent one is uploaded to the stream texture.
+	bool streaming = false;
+	double stream_fps = 30.0;
+	StreamFrame stream_frames[STREAM_RING_SIZE];
+	uint64_t stream_seq = 0;
+	uint64_t stream_next_capture = 0;
+	uint64_t stream_frames_dropped = 0;
+	Ref<ImageTexture> stream_texture;
+
+	// Delta detection, converted snapshots are compared with the previous one in
+	// tiles. Stream texture is updated only in the changed regions.
+	bool delta_detection = false;
+	bool stream_full_upload = true;
+	Array stream_pending_delta;
+
+	// Full-page capture, the page is scrolled by script one viewport at a time.
+	// Next tile is scrolled to as soon as the previous one is captured, while
+	// the previous one is converted and stitched.
+	FullPageCapture full_page;
 
 	Ref<ImageTexture> icon_main;
 	Ref<ImageTexture> icon_error;
@@ -32,6 +310,62 @@ protected:
 	void _draw_placeholder();
 	void _draw_error(const String &p_error);
 
+	bool _can_queue_commands() const;
+	void _queue_command(CommandType p_type, const String &p_arg = String(), int p_width = 0, uint64_t p_id = 0);
+	void _run_command(const Command &p_command);
+	void _queue_geometry_update();
+	void _update_geometry(bool p_force);
+	void _update_processing();
+	void _flush_script_batch();
+	void _wake_events();
+	void _dispatch_events();
+	void _cancel_script_evaluations(bool p_queued);
+	void _update_document_scripts();
+	void _start_document_stream();
+	void _finish_document_stream(const String &p_error, bool p_abort_backend);
+	void _process_document_stream();
+
+	uint64_t _request_capture(int p_width, bool p_stream, int p_slot, int p_tile = -1);
+	void _clear_snapshot_requests();
+	void _snapshot_done(const SnapshotRequest &p_request);
+	void _accumulate_stream_delta(const Variant &p_delta);
+	void _release_stream_frame(StreamFrame &p_frame);
+	void _process_stream();
+
+	static String _make_isolated_script(const String &p_script);
+	static String _make_message_script(const String &p_expression);
+	static String _get_binary_bridge_script();
+	String _get_binary_endpoint() const;
+	static String _get_channel_bridge_script();
+	static bool _is_channel_message(const String &p_message);
+	Variant _decode_channel_payload(const String &p_payload) const;
+	void _channel_message_received(const String &p_message);
+	void _flush_message_channel(const String &p_channel, MessageChannel &p_state);
+	void _flush_message_channels();
+	static String _get_rpc_bridge_script();
+	void _rpc_message(const Dictionary &p_message);
+	void _rpc_reply(const Variant &p_id, const Variant &p_result, const String &p_error);
+	void _rpc_completed(const Variant &p_result, const Variant &p_id);
+	void _script_call_finished(uint64_t p_id, const Variant &p_result, const String &p_error);
+	void _cancel_script_calls();
+	void _process_rpc();
+	static String _get_state_bridge_script();
+	void _state_add_op(SharedState &p_state, const Array &p_path, const Variant &p_value, bool p_remove);
+	void _state_diff(SharedState &p_state, const Variant &p_old, const Variant &p_new, Array &p_path);
+	void _state_resolve(SharedState &p_state);
+	void _state_changed();
+	void _resync_shared_states();
+	void _flush_shared_states();
+	void _full_page_message(const Dictionary &p_message);
+	void _full_page_scroll(int p_tile);
+	void _full_page_tile_captured(int p_tile);
+	void _full_page_tile_ready(int p_tile, const Ref<Image> &p_image);
+	void _full_page_finish(bool p_success, bool p_restore);
+	void _process_full_page();
+
+	static void _start_snapshot_worker();
+	static void _stop_snapshot_worker();
+
 public:
 	WebViewOverlay();
 	~WebViewOverlay();
@@ -51,9 +385,87 @@ public:
 	String get_title() const;
 
 	void load_string(const String &p_source);
+	Error load_string_stream(Object *p_target, const StringName &p_method);
+	bool is_document_streaming() const;
+	Dictionary get_document_stream_stats() const;
+	Dictionary get_resource_cache_stats() const;
+	void clear_resource_cache();
 	void execute_java_script(const String &p_script);
 
+	void set_event_budget_usec(int p_usec);
+	int get_event_budget_usec() const;
+	Dictionary get_event_stats() const;
+
+	void set_decode_messages(bool p_enabled);
+	bool is_decoding_messages() const;
+
+	void set_script_batching(bool p_enabled);
+	bool is_script_batching() const;
+	void set_script_batch_max_size(int p_size);
+	int get_script_batch_max_size() const;
+	Dictionary get_script_batch_stats() const;
+
+	void send_binary(const String &p_channel, const PoolByteArray &p_data);
+
+	void set_message_policy(const String &p_channel, MessagePolicy p_policy);
+	MessagePolicy get_message_policy(const String &p_channel) const;
+	Dictionary get_message_stats() const;
+
+	void add_document_start_script(const String &p_name, const String &p_source);
+	void remove_document_start_script(const String &p_name);
+	PoolStringArray get_document_start_scripts() const;
+
+	uint64_t evaluate_java_script(const String &p_script);
+	int get_pending_evaluations() const;
+
+	void register_script_method(const String &p_name, Object *p_target, const StringName &p_method);
+	void unregister_script_method(const String &p_name);
+	PoolStringArray get_script_methods() const;
+	uint64_t call_script_function(const String &p_function, const Array &p_args = Array(), double p_timeout = -1.0);
+	int get_pending_script_calls() const;
+	void set_script_call_timeout(double p_timeout);
+	double get_script_call_timeout() const;
+	Dictionary get_script_call_stats() const;
+
+	void set_shared_state(const String &p_name, const Dictionary &p_state);
+	void set_shared_value(const String &p_name, const Array &p_path, const Variant &p_value);
+	void remove_shared_value(const String &p_name, const Array &p_path);
+	Dictionary get_shared_state(const String &p_name);
+	void remove_shared_state(const String &p_name);
+	PoolStringArray get_shared_state_names() const;
+	Dictionary get_shared_state_stats() const;
+
 	void get_snapshot(int p_width);
+	Error get_full_page_snapshot(int p_width, bool p_tiled = false);
+	bool is_full_page_snapshot_active() const;
+	Ref<Texture> get_texture() const;
+
+	void set_max_snapshots_in_flight(int p_max);
+	int get_max_snapshots_in_flight() const;
+	Dictionary get_snapshot_stats() const;
+
+	void recycle_snapshot(const Ref<Image> &p_image);
+	void clear_snapshot_pool();
+
+	void set_snapshot_cache_enabled(bool p_enabled);
+	bool is_snapshot_cache_enabled() const;
+
+	void set_snapshot_fingerprint(const String &p_fingerprint);
+	String get_snapshot_fingerprint() const;
+
+	Ref<Image> get_cached_snapshot(const String &p_url, int p_width);
+	void clear_snapshot_cache();
+
+	void set_streaming(bool p_enabled);
+	bool is_streaming() const;
+
+	void set_stream_fps(double p_fps);
+	double get_stream_fps() const;
+
+	int get_stream_dropped_frames() const;
+
+	void set_delta_detection(bool p_enabled);
+	bool is_delta_detection_enabled() const;
 
 	bool can_go_back() const;
 	bool can_go_forward() const;
@@ -66,8 +478,37 @@ public:
 	void reload();
 	void stop();
 
+	// Backend callbacks. Messages, navigation and new window events are posted with
+	// _post_event (safe on any thread), script messages are then dispatched to the
+	// internal handlers or emitted with the callback signal. Sources are converted on
+	// the snapshot worker thread, result is delivered to _snapshot_ready with a deferred call.
+	// _document_stream_done is called on the main thread when the backend has delivered
+	// the whole document, _document_stream_closed when the view drops the stream.
+	void _post_event(InboundEventType p_type, const String &p_payload = String());
+	void _message_received(const String &p_message);
+	void _script_evaluated(uint64_t p_id, const Variant &p_result);
+	void _script_evaluated_json(uint64_t p_id, const String &p_json);
+	void _script_failed(uint64_t p_id, const String &p_error);
+	void _snapshot_ready_source(uint64_t p_id, WebViewSnapshotSource *p_source);
+	void _snapshot_ready(uint64_t p_id, const Ref<Image> &p_image, const Variant &p_delta = Variant());
+	void _snapshot_failed(uint64_t p_id);
+	void _document_stream_done();
+	void _document_stream_closed();
+	// Binary endpoint requests (see webview_binary.cpp) are answered on the main thread,
+	// p_path follows the endpoint URL. Returns the HTTP status.
+	static int _binary_request(const String &p_path, const PoolByteArray &p_body, PoolByteArray &r_response);
+	// Defines the binary endpoint of the view, backends prepend it to the bridge script.
+	String _get_binary_endpoint_script() const;
+
+	// Script injected by the backends at document start, after webviewMessage.
+	static String get_bridge_script();
+	// Local resource URL of a streamed document.
+	static String get_document_stream_url(uint64_t p_id);
+
 	static void init();
 	static void finish();
 };
 
+VARIANT_ENUM_CAST(WebViewOverlay::MessagePolicy);
+
 #endif // WEB_VIEW_H
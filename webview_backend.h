@@ -0,0 +1,117 @@
+/*************************************************************************/
+/*  webview_backend.h                                                    */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_BACKEND_H
+#define WEB_VIEW_BACKEND_H
+
+#include "webview.h"
+
+/*************************************************************************/
+
+// Snapshot data handed over to the conversion worker with
+// WebViewOverlay::_snapshot_ready_source. lock() and the destructor are called
+// on the worker thread, backends should do the expensive work (copy, decode,
+// scale) in lock() and release their resources in the destructor.
+class WebViewSnapshotSource {
+public:
+	enum Type {
+		TYPE_PIXELS,
+		TYPE_PNG,
+	};
+
+	Type type = TYPE_PIXELS;
+	WebViewPixels::Format format = WebViewPixels::FORMAT_RGBA8;
+
+	// Returns pixels and sets width, height and stride, or PNG file data and sets size.
+	// Returns nullptr on failure.
+	int width = 0;
+	int height = 0;
+	int stride = 0;
+	int size = 0;
+	virtual const uint8_t *lock() = 0;
+
+	virtual ~WebViewSnapshotSource() {}
+};
+
+/*************************************************************************/
+
+// Interface implemented by the platform (and mock) web view backends.
+// WebViewOverlay owns the view state machine and the control state, and
+// forwards calls to the backend only when it is ready. Backends report events
+// (navigation, new window, script messages) with WebViewOverlay::_post_event.
+class WebViewOverlayImplementation {
+public:
+	WebViewOverlay *control = nullptr;
+	// Chunks collected by the default document stream implementation.
+	Vector<uint8_t> document_stream_buffer;
+
+	// Starts view creation, returns ERR_UNAVAILABLE if host window is not ready yet.
+	virtual Error create() = 0;
+	virtual void destroy() = 0;
+	virtual bool is_created() const = 0;
+	virtual bool is_ready() const = 0;
+
+	// Called every frame while control internal processing is enabled.
+	virtual void process() {}
+	virtual bool needs_process() const { return false; }
+
+	// Overlay backends receive bounds in the native window points, offscreen
+	// backends in the control pixels.
+	virtual bool is_offscreen() const { return false; }
+	virtual void set_bounds(const Rect2 &p_rect) = 0;
+	virtual void set_visible(bool p_visible) = 0;
+
+	virtual void set_no_background(bool p_bg) = 0;
+	virtual void set_user_agent(const String &p_user_agent) = 0;
+	virtual String get_user_agent() const = 0;
+	virtual void set_zoom_level(double p_zoom) = 0;
+	virtual double get_zoom_level() const = 0;
+
+	virtual void navigate(const String &p_url) = 0;
+	virtual String get_url() const = 0;
+	virtual String get_title() const = 0;
+	virtual void load_string(const String &p_source) = 0;
+	virtual void exec_script(const String &p_script) = 0;
+	// Replaces the user document-start script (installed after the bridge script),
+	// it is applied from the next navigation. Empty source removes it.
+	virtual void set_document_start_script(const String &p_source) = 0;
+	// Streamed load_string, the document is written in UTF-8 chunks while can_write
+	// returns true. Backends serving p_url (local resource scheme) deliver the chunks
+	// as they are written, the default implementation collects them and loads the
+	// whole document at the end. After document_stream_end, backend calls
+	// WebViewOverlay::_document_stream_done once the last chunk is delivered, and
+	// WebViewOverlay::_document_stream_closed if the view drops the stream.
+	virtual void document_stream_begin(const String &p_url);
+	virtual bool document_stream_can_write();
+	virtual void document_stream_write(const CharString &p_chunk);
+	virtual void document_stream_end();
+	virtual void document_stream_abort();
+	// Result is reported with WebViewOverlay::_script_evaluated (or _script_evaluated_json) or _script_failed using p_id.
+	virtual void evaluate_script(const String &p_script, uint64_t p_id) = 0;
+	// Base URL of the binary endpoint served with WebViewOverlay::_binary_request,
+	// empty if the backend has none (binary channel is not supported).
+	virtual String get_binary_endpoint() const { return String(); }
+	// Result is reported with WebViewOverlay::_snapshot_ready_source (or _snapshot_ready) or _snapshot_failed using p_id.
+	virtual void capture(int p_width, uint64_t p_id) = 0;
+	virtual Ref<Texture> get_texture() const { return Ref<Texture>(); }
+
+	virtual bool can_go_back() const = 0;
+	virtual bool can_go_forward() const = 0;
+	virtual bool is_loading() const = 0;
+	virtual bool is_secure_content() const = 0;
+	virtual void go_back() = 0;
+	virtual void go_forward() = 0;
+	virtual void reload() = 0;
+	virtual void stop() = 0;
+
+	virtual ~WebViewOverlayImplementation() {}
+
+	// Implemented by the native backend of the current platform.
+	static int init_native();
+	static void finish_native();
+	static String get_native_error(int p_status);
+	static WebViewOverlayImplementation *create_native();
+};
+
+#endif // WEB_VIEW_BACKEND_H
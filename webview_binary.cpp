@@ -0,0 +1,96 @@
+/*************************************************************************/
+/*  webview_binary.cpp                                                   */
+/*************************************************************************/
+
+#include "webview.h"
+#include "webview_backend.h"
+
+/*************************************************************************/
+
+// Binary payloads bypass the string messages, they are HTTP bodies of the
+// requests to the backend binary endpoint (custom scheme handler on WebKit,
+// intercepted https host on Edge), so the data is transferred as is:
+//
+//   <endpoint><instance id>/get/<payload id>  GET, payload of send_binary.
+//   <endpoint><instance id>/send/<channel>    POST, webviewSendBinary data.
+//
+// Requests have no custom headers and the body has no content type, so the
+// page does not send CORS preflight requests. Responses allow any origin.
+
+static const char *_binary_bridge_script =
+		"(function(){"
+		"var listeners={};"
+		"window.webviewSendBinary=function(channel,data){"
+		"var e=window.__webviewBinaryEndpoint;if(!e){return Promise.reject(new Error(\"Binary channel is not supported.\"));}"
+		"var b=ArrayBuffer.isView(data)?new Uint8Array(data.buffer,data.byteOffset,data.byteLength):new Uint8Array(data);"
+		"return fetch(e+\"send/\"+encodeURIComponent(String(channel)),{method:\"POST\",body:b}).then(function(r){if(!r.ok){throw new Error(\"Binary transfer failed (\"+r.status+\").\");}});};"
+		"window.webviewOnBinary=function(channel,callback){if(callback){listeners[channel]=callback;}else{delete listeners[channel];}};"
+		"window.__webviewBinaryFetch=function(channel,url){"
+		"fetch(url).then(function(r){if(!r.ok){throw new Error(\"Binary transfer failed (\"+r.status+\").\");}return r.arrayBuffer();})"
+		".then(function(b){var cb=listeners[channel];if(cb){cb(new Uint8Array(b));}}).catch(function(e){console.error(e);});};"
+		"})();";
+
+String WebViewOverlay::_get_binary_bridge_script() {
+	return _binary_bridge_script;
+}
+
+String WebViewOverlay::_get_binary_endpoint() const {
+	if (data == nullptr) {
+		return String();
+	}
+	String endpoint = data->get_binary_endpoint();
+	if (endpoint.empty()) {
+		return String();
+	}
+	return endpoint + String::num_uint64(get_instance_id()) + "/";
+}
+
+String WebViewOverlay::_get_binary_endpoint_script() const {
+	return "var __webviewBinaryEndpoint=\"" + _get_binary_endpoint().json_escape() + "\";";
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::send_binary(const String &p_channel, const PoolByteArray &p_data) {
+	ERR_FAIL_COND(!is_ready());
+	String endpoint = _get_binary_endpoint();
+	ERR_FAIL_COND_MSG(endpoint.empty(), "Binary channel is not supported by this backend.");
+
+	// Batched scripts run first, the receiver may be registered by them.
+	_flush_script_batch();
+
+	// Payload shares the buffer of p_data until the page fetches it.
+	uint32_t id = ++binary_send_seq;
+	binary_outbox[id] = p_data;
+	data->exec_script("__webviewBinaryFetch(\"" + p_channel.json_escape() + "\",\"" + endpoint.json_escape() + "get/" + itos(id) + "\");");
+}
+
+int WebViewOverlay::_binary_request(const String &p_path, const PoolByteArray &p_body, PoolByteArray &r_response) {
+	Vector<String> parts = p_path.split("/", true, 2);
+	if (parts.size() != 3) {
+		return 400;
+	}
+	WebViewOverlay *control = Object::cast_to<WebViewOverlay>(ObjectDB::get_instance(parts[0].to_int64()));
+	if (!control) {
+		return 404;
+	}
+
+	if (parts[1] == "get") {
+		// Each payload is fetched once.
+		Map<uint32_t, PoolByteArray>::Element *E = control->binary_outbox.find(parts[2].to_int());
+		if (!E) {
+			return 404;
+		}
+		r_response = E->get();
+		control->binary_outbox.erase(E);
+		return 200;
+	} else if (parts[1] == "send") {
+		if (p_body.size() > MAX_BINARY_TRANSFER_SIZE) {
+			return 413;
+		}
+		// Request is answered first, the signal handler may free the control.
+		control->call_deferred("emit_signal", "binary_received", parts[2].percent_decode(), p_body);
+		return 200;
+	}
+	return 400;
+}
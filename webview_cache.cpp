@@ -0,0 +1,348 @@
+/*************************************************************************/
+/*  webview_cache.cpp                                                    */
+/*************************************************************************/
+
+#include "webview_cache.h"
+
+#include "core/io/compression.h"
+#include "core/os/dir_access.h"
+#include "core/os/file_access.h"
+#include "core/os/memory.h"
+#include "core/project_settings.h"
+
+#if defined(WINDOWS_ENABLED)
+#include <windows.h>
+#elif defined(UNIX_ENABLED)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static const char *_cache_dir = "user://webview_cache";
+
+bool WebViewSnapshotCache::initialized = false;
+uint64_t WebViewSnapshotCache::max_size = 64 * 1024 * 1024;
+uint8_t *WebViewSnapshotCache::index = nullptr;
+bool WebViewSnapshotCache::index_mapped = false;
+uint64_t WebViewSnapshotCache::hits = 0;
+uint64_t WebViewSnapshotCache::misses = 0;
+
+/*************************************************************************/
+
+// Maps the index file to memory, returns nullptr if mapping is not supported or failed.
+static uint8_t *_map_index(const String &p_path, size_t p_size) {
+#if defined(WINDOWS_ENABLED)
+	HANDLE file = CreateFileW((LPCWSTR)p_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	// Mapping extends the file to the index size, view keeps the mapping alive.
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, 0, (DWORD)p_size, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr) {
+		return nullptr;
+	}
+	void *ptr = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, p_size);
+	CloseHandle(mapping);
+	return (uint8_t *)ptr;
+#elif defined(UNIX_ENABLED)
+	int fd = open(p_path.utf8().get_data(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		return nullptr;
+	}
+	if (ftruncate(fd, p_size) != 0) {
+		close(fd);
+		return nullptr;
+	}
+	void *ptr = mmap(nullptr, p_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return (ptr == MAP_FAILED) ? nullptr : (uint8_t *)ptr;
+#else
+	return nullptr;
+#endif
+}
+
+static void _unmap_index(uint8_t *p_ptr, size_t p_size) {
+#if defined(WINDOWS_ENABLED)
+	FlushViewOfFile(p_ptr, p_size);
+	UnmapViewOfFile(p_ptr);
+#elif defined(UNIX_ENABLED)
+	munmap(p_ptr, p_size);
+#endif
+}
+
+/*************************************************************************/
+
+size_t WebViewSnapshotCache::_get_index_size() {
+	return sizeof(IndexHeader) + INDEX_CAPACITY * sizeof(IndexEntry);
+}
+
+WebViewSnapshotCache::IndexHeader *WebViewSnapshotCache::_header() {
+	return (IndexHeader *)index;
+}
+
+WebViewSnapshotCache::IndexEntry *WebViewSnapshotCache::_entries() {
+	return (IndexEntry *)(index + sizeof(IndexHeader));
+}
+
+WebViewSnapshotCache::IndexEntry *WebViewSnapshotCache::_find(uint64_t p_key) {
+	IndexEntry *entries = _entries();
+	for (int i = 0; i < INDEX_CAPACITY; i++) {
+		if ((entries[i].last_used != 0) && (entries[i].key == p_key)) {
+			return &entries[i];
+		}
+	}
+	return nullptr;
+}
+
+bool WebViewSnapshotCache::_open() {
+	if (initialized) {
+		return index != nullptr;
+	}
+	initialized = true;
+
+	DirAccess *da = DirAccess::create(DirAccess::ACCESS_USERDATA);
+	Error err = da->make_dir_recursive(_cache_dir);
+	memdelete(da);
+	ERR_FAIL_COND_V_MSG(err != OK, false, "Can't create WebView snapshot cache directory.");
+
+	String path = String(_cache_dir).plus_file("index.bin");
+	size_t size = _get_index_size();
+
+	index = _map_index(ProjectSettings::get_singleton()->globalize_path(path), size);
+	index_mapped = (index != nullptr);
+	if (!index_mapped) {
+		index = (uint8_t *)memalloc(size);
+		memset(index, 0, size);
+		FileAccess *f = FileAccess::open(path, FileAccess::READ);
+		if (f) {
+			if (f->get_len() == size) {
+				f->get_buffer(index, size);
+			}
+			memdelete(f);
+		}
+	}
+
+	IndexHeader *header = _header();
+	if ((header->magic != INDEX_MAGIC) || (header->capacity != INDEX_CAPACITY)) {
+		_reset();
+	}
+	return true;
+}
+
+void WebViewSnapshotCache::_reset() {
+	// Index is missing or from the different version, remove all entry files.
+	DirAccess *da = DirAccess::open(_cache_dir);
+	if (da) {
+		da->list_dir_begin();
+		String name = da->get_next();
+		while (!name.empty()) {
+			if (!da->current_is_dir() && (name.get_extension() == "wvc")) {
+				da->remove(name);
+			}
+			name = da->get_next();
+		}
+		da->list_dir_end();
+		memdelete(da);
+	}
+
+	memset(index, 0, _get_index_size());
+	IndexHeader *header = _header();
+	header->magic = INDEX_MAGIC;
+	header->capacity = INDEX_CAPACITY;
+}
+
+void WebViewSnapshotCache::_remove(IndexEntry *p_entry) {
+	String path = _get_entry_path(p_entry->key);
+	DirAccess *da = DirAccess::create_for_path(path);
+	da->remove(path);
+	memdelete(da);
+
+	IndexHeader *header = _header();
+	header->total_size -= MIN(header->total_size, p_entry->size);
+	memset(p_entry, 0, sizeof(IndexEntry));
+}
+
+void WebViewSnapshotCache::_evict(uint64_t p_size) {
+	// Removes least recently used entries until the new entry fits in the budget and in the index.
+	IndexHeader *header = _header();
+	IndexEntry *entries = _entries();
+	while (true) {
+		bool has_free = false;
+		IndexEntry *oldest = nullptr;
+		for (int i = 0; i < INDEX_CAPACITY; i++) {
+			if (entries[i].last_used == 0) {
+				has_free = true;
+			} else if (!oldest || (entries[i].last_used < oldest->last_used)) {
+				oldest = &entries[i];
+			}
+		}
+		if ((has_free && (header->total_size + p_size <= max_size)) || !oldest) {
+			break;
+		}
+		_remove(oldest);
+	}
+}
+
+uint64_t WebViewSnapshotCache::_make_key(const String &p_url, const Size2 &p_viewport, int p_width, const String &p_fingerprint, String &r_key_string) {
+	r_key_string = p_url + "\n" + itos(p_viewport.width) + "x" + itos(p_viewport.height) + "\n" + itos(p_width) + "\n" + p_fingerprint;
+	return r_key_string.hash64();
+}
+
+String WebViewSnapshotCache::_get_entry_path(uint64_t p_key) {
+	return String(_cache_dir).plus_file(String::num_uint64(p_key, 16) + ".wvc");
+}
+
+/*************************************************************************/
+
+Ref<Image> WebViewSnapshotCache::load(const String &p_url, const Size2 &p_viewport, int p_width, const String &p_fingerprint) {
+	String key_string;
+	uint64_t key = _make_key(p_url, p_viewport, p_width, p_fingerprint, key_string);
+
+	IndexEntry *entry = (_open()) ? _find(key) : nullptr;
+	if (!entry) {
+		misses++;
+		return Ref<Image>();
+	}
+
+	Ref<Image> image;
+	FileAccess *f = FileAccess::open(_get_entry_path(key), FileAccess::READ);
+	if (f) {
+		uint32_t magic = f->get_32();
+		int width = f->get_32();
+		int height = f->get_32();
+		String stored_key = f->get_pascal_string();
+		int compressed_size = f->get_32();
+		// Stored key is compared to rule out hash collisions.
+		if ((magic == ENTRY_MAGIC) && (stored_key == key_string) && (width > 0) && (height > 0) && (width <= Image::MAX_WIDTH) && (height <= Image::MAX_HEIGHT) && (compressed_size > 0) && ((uint64_t)compressed_size <= f->get_len() - f->get_position())) {
+			Vector<uint8_t> compressed;
+			compressed.resize(compressed_size);
+			if (f->get_buffer(compressed.ptrw(), compressed_size) == compressed_size) {
+				PoolVector<uint8_t> pixels;
+				pixels.resize(width * height * 4);
+				int size;
+				{
+					PoolVector<uint8_t>::Write w = pixels.write();
+					size = Compression::decompress(w.ptr(), pixels.size(), compressed.ptr(), compressed_size, Compression::MODE_ZSTD);
+				}
+				if (size == pixels.size()) {
+					image = memnew(Image(width, height, false, Image::FORMAT_RGBA8, pixels));
+				}
+			}
+		}
+		memdelete(f);
+	}
+
+	if (image.is_null()) {
+		_remove(entry);
+		misses++;
+		return Ref<Image>();
+	}
+
+	entry->last_used = ++_header()->clock;
+	hits++;
+	return image;
+}
+
+void WebViewSnapshotCache::store(const String &p_url, const Size2 &p_viewport, int p_width, const String &p_fingerprint, const Ref<Image> &p_image) {
+	ERR_FAIL_COND(p_image.is_null() || p_image->empty());
+	if (!_open()) {
+		return;
+	}
+
+	Ref<Image> image = p_image;
+	if ((image->get_format() != Image::FORMAT_RGBA8) || image->has_mipmaps()) {
+		image = p_image->duplicate();
+		image->clear_mipmaps();
+		image->convert(Image::FORMAT_RGBA8);
+	}
+
+	String key_string;
+	uint64_t key = _make_key(p_url, p_viewport, p_width, p_fingerprint, key_string);
+
+	IndexEntry *entry = _find(key);
+	if (entry) {
+		_remove(entry);
+	}
+
+	// Pages compress well (mostly flat areas), entries are a fraction of the
+	// raw pixels on disk and in the budget, and faster to read back.
+	PoolVector<uint8_t> pixels = image->get_data();
+	Vector<uint8_t> compressed;
+	{
+		PoolVector<uint8_t>::Read r = pixels.read();
+		compressed.resize(Compression::get_max_compressed_buffer_size(pixels.size(), Compression::MODE_ZSTD));
+		int compressed_size = Compression::compress(compressed.ptrw(), r.ptr(), pixels.size(), Compression::MODE_ZSTD);
+		ERR_FAIL_COND_MSG(compressed_size <= 0, "Can't compress WebView snapshot cache entry.");
+		compressed.resize(compressed_size);
+	}
+	CharString key_utf8 = key_string.utf8();
+	uint64_t size = 20 + key_utf8.length() + compressed.size();
+	if (size > max_size) {
+		return;
+	}
+	_evict(size);
+
+	FileAccess *f = FileAccess::open(_get_entry_path(key), FileAccess::WRITE);
+	ERR_FAIL_COND_MSG(!f, "Can't write WebView snapshot cache entry.");
+	f->store_32(ENTRY_MAGIC);
+	f->store_32(image->get_width());
+	f->store_32(image->get_height());
+	f->store_pascal_string(key_string);
+	f->store_32(compressed.size());
+	f->store_buffer(compressed.ptr(), compressed.size());
+	bool failed = (f->get_error() != OK);
+	memdelete(f);
+	ERR_FAIL_COND_MSG(failed, "Can't write WebView snapshot cache entry.");
+
+	IndexHeader *header = _header();
+	IndexEntry *entries = _entries();
+	for (int i = 0; i < INDEX_CAPACITY; i++) {
+		if (entries[i].last_used == 0) {
+			entries[i].key = key;
+			entries[i].size = size;
+			entries[i].last_used = ++header->clock;
+			header->total_size += size;
+			break;
+		}
+	}
+}
+
+void WebViewSnapshotCache::clear() {
+	if (!_open()) {
+		return;
+	}
+	_reset();
+}
+
+uint64_t WebViewSnapshotCache::get_total_size() {
+	// Cache directory is not created only to report its size.
+	if (index == nullptr) {
+		return 0;
+	}
+	return _header()->total_size;
+}
+
+void WebViewSnapshotCache::init_settings() {
+	max_size = (uint64_t)(int)GLOBAL_DEF("webview/snapshot_cache/max_size_mb", 64) * 1024 * 1024;
+}
+
+void WebViewSnapshotCache::finish() {
+	if (index == nullptr) {
+		return;
+	}
+
+	size_t size = _get_index_size();
+	if (index_mapped) {
+		_unmap_index(index, size);
+	} else {
+		FileAccess *f = FileAccess::open(String(_cache_dir).plus_file("index.bin"), FileAccess::WRITE);
+		if (f) {
+			f->store_buffer(index, size);
+			memdelete(f);
+		}
+		memfree(index);
+	}
+	index = nullptr;
+	initialized = false;
+}
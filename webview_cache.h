@@ -0,0 +1,75 @@
+/*************************************************************************/
+/*  webview_cache.h                                                      */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_CACHE_H
+#define WEB_VIEW_CACHE_H
+
+#include "core/image.h"
+#include "core/ustring.h"
+
+/*************************************************************************/
+
+// Persistent snapshot cache shared by all views, stored in
+// "user://webview_cache". Entries are keyed by URL, viewport size, snapshot
+// width and a user supplied content fingerprint, and evicted in LRU order
+// when the total size exceeds "webview/snapshot_cache/max_size_mb".
+//
+// Index is a fixed size table of entries, memory-mapped where supported (or
+// kept in memory and written on finish), each entry is stored in a separate
+// file with the Zstandard compressed RGBA8 pixels.
+class WebViewSnapshotCache {
+	enum {
+		INDEX_MAGIC = 0x32435657, // "WVC2"
+		INDEX_CAPACITY = 1024,
+		ENTRY_MAGIC = 0x45435657, // "WVCE"
+	};
+
+	struct IndexHeader {
+		uint32_t magic;
+		uint32_t capacity;
+		uint64_t clock;
+		uint64_t total_size;
+	};
+
+	struct IndexEntry {
+		uint64_t key;
+		uint64_t last_used; // 0 if entry is free.
+		uint64_t size;
+	};
+
+	static bool initialized;
+	static uint64_t max_size;
+	static uint8_t *index;
+	static bool index_mapped;
+
+	static uint64_t hits;
+	static uint64_t misses;
+
+	static size_t _get_index_size();
+	static IndexHeader *_header();
+	static IndexEntry *_entries();
+	static IndexEntry *_find(uint64_t p_key);
+	static bool _open();
+	static void _reset();
+	static void _evict(uint64_t p_size);
+	static void _remove(IndexEntry *p_entry);
+
+	static uint64_t _make_key(const String &p_url, const Size2 &p_viewport, int p_width, const String &p_fingerprint, String &r_key_string);
+	static String _get_entry_path(uint64_t p_key);
+
+public:
+	static Ref<Image> load(const String &p_url, const Size2 &p_viewport, int p_width, const String &p_fingerprint);
+	static void store(const String &p_url, const Size2 &p_viewport, int p_width, const String &p_fingerprint, const Ref<Image> &p_image);
+	static void clear();
+
+	static uint64_t get_hits() { return hits; }
+	static uint64_t get_misses() { return misses; }
+	// Size of the entries, 0 until the cache is used.
+	static uint64_t get_total_size();
+
+	static void init_settings();
+	static void finish();
+};
+
+#endif // WEB_VIEW_CACHE_H
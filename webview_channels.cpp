@@ -0,0 +1,197 @@
+/*************************************************************************/
+/*  webview_channels.cpp                                                 */
+/*************************************************************************/
+
+#include "webview.h"
+#include "webview_json.h"
+
+/*************************************************************************/
+
+// Channel message: prefix + "channel\n" + payload. Objects are posted JSON
+// encoded, strings as is.
+
+static const char *_channel_prefix = "__webview_ch__:";
+
+static const char *_channel_bridge_script =
+		"window.webviewPost=function(channel,message){"
+		"channel=String(channel);if(channel.indexOf(\"\\n\")!==-1){throw new Error(\"Invalid channel name.\");}"
+		"webviewMessage(\"__webview_ch__:\"+channel+\"\\n\"+((typeof message===\"string\")?message:JSON.stringify(message)));};";
+
+String WebViewOverlay::_get_channel_bridge_script() {
+	return _channel_bridge_script;
+}
+
+bool WebViewOverlay::_is_channel_message(const String &p_message) {
+	return p_message.begins_with(_channel_prefix);
+}
+
+/*************************************************************************/
+
+static bool _is_number(const Variant &p_value) {
+	return (p_value.get_type() == Variant::INT) || (p_value.get_type() == Variant::REAL);
+}
+
+static Variant _accumulate(const Variant &p_total, const Variant &p_value) {
+	if (_is_number(p_total) && _is_number(p_value)) {
+		if ((p_total.get_type() == Variant::INT) && (p_value.get_type() == Variant::INT)) {
+			return (int64_t)p_total + (int64_t)p_value;
+		}
+		return (double)p_total + (double)p_value;
+	}
+	if ((p_total.get_type() == Variant::DICTIONARY) && (p_value.get_type() == Variant::DICTIONARY)) {
+		// Numeric fields are summed, other fields keep the latest value.
+		Dictionary total = p_total;
+		Dictionary value = p_value;
+		List<Variant> keys;
+		value.get_key_list(&keys);
+		for (List<Variant>::Element *E = keys.front(); E; E = E->next()) {
+			const Variant &key = E->get();
+			if (total.has(key)) {
+				total[key] = _accumulate(total[key], value[key]);
+			} else {
+				total[key] = value[key];
+			}
+		}
+		return total;
+	}
+	return p_value;
+}
+
+Variant WebViewOverlay::_decode_channel_payload(const String &p_payload) const {
+	if (!decode_messages) {
+		return p_payload;
+	}
+	// Payloads which are not valid JSON are emitted as is.
+	Variant decoded;
+	if (WebViewJSON::decode(p_payload, decoded) == OK) {
+		return decoded;
+	}
+	return p_payload;
+}
+
+void WebViewOverlay::_channel_message_received(const String &p_message) {
+	int prefix_len = strlen(_channel_prefix);
+	int sep = p_message.find_char('\n', prefix_len);
+	ERR_FAIL_COND_MSG(sep == -1, "Invalid channel message.");
+	String channel = p_message.substr(prefix_len, sep - prefix_len);
+	String payload = p_message.substr(sep + 1, p_message.length() - sep - 1);
+
+	channel_messages_received++;
+
+	Map<String, MessageChannel>::Element *E = message_channels.find(channel);
+	if (!E) {
+		channel_messages_emitted++;
+		emit_signal("channel_message", channel, _decode_channel_payload(payload));
+		return;
+	}
+
+	MessageChannel &state = E->get();
+	switch (state.policy) {
+		case MESSAGE_POLICY_LATEST: {
+			state.latest = payload;
+		} break;
+		case MESSAGE_POLICY_ACCUMULATE: {
+			// Always decoded, undecodable payloads replace the total.
+			Variant value;
+			if (WebViewJSON::decode(payload, value) != OK) {
+				value = payload;
+			}
+			state.accumulated = state.pending ? _accumulate(state.accumulated, value) : value;
+		} break;
+		case MESSAGE_POLICY_BATCH: {
+			state.batch.push_back(_decode_channel_payload(payload));
+		} break;
+		default: {
+			channel_messages_emitted++;
+			emit_signal("channel_message", channel, _decode_channel_payload(payload));
+			return;
+		}
+	}
+	if (!state.pending) {
+		state.pending = true;
+		message_channels_pending++;
+		// Messages can arrive outside of the backend processing.
+		set_process_internal(true);
+	}
+}
+
+void WebViewOverlay::_flush_message_channel(const String &p_channel, MessageChannel &p_state) {
+	if (!p_state.pending) {
+		return;
+	}
+	Variant message;
+	switch (p_state.policy) {
+		case MESSAGE_POLICY_LATEST: {
+			message = _decode_channel_payload(p_state.latest);
+			p_state.latest = String();
+		} break;
+		case MESSAGE_POLICY_ACCUMULATE: {
+			message = p_state.accumulated;
+			p_state.accumulated = Variant();
+		} break;
+		case MESSAGE_POLICY_BATCH: {
+			message = p_state.batch;
+			p_state.batch = Array();
+		} break;
+		default: {
+		} break;
+	}
+	p_state.pending = false;
+	message_channels_pending--;
+
+	channel_messages_emitted++;
+	emit_signal("channel_message", p_channel, message);
+}
+
+void WebViewOverlay::_flush_message_channels() {
+	// Collected first, signal handlers may change the channel policies.
+	List<String> pending;
+	for (Map<String, MessageChannel>::Element *E = message_channels.front(); E; E = E->next()) {
+		if (E->get().pending) {
+			pending.push_back(E->key());
+		}
+	}
+	for (List<String>::Element *E = pending.front(); E; E = E->next()) {
+		Map<String, MessageChannel>::Element *C = message_channels.find(E->get());
+		if (C) {
+			_flush_message_channel(C->key(), C->get());
+		}
+	}
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::set_message_policy(const String &p_channel, MessagePolicy p_policy) {
+	ERR_FAIL_INDEX(p_policy, MESSAGE_POLICY_BATCH + 1);
+
+	Map<String, MessageChannel>::Element *E = message_channels.find(p_channel);
+	if (E) {
+		if (E->get().policy == p_policy) {
+			return;
+		}
+		// Messages coalesced with the previous policy are emitted first.
+		_flush_message_channel(p_channel, E->get());
+		E = message_channels.find(p_channel);
+	}
+	if (p_policy == MESSAGE_POLICY_IMMEDIATE) {
+		if (E) {
+			message_channels.erase(E);
+		}
+		return;
+	}
+	message_channels[p_channel].policy = p_policy;
+}
+
+WebViewOverlay::MessagePolicy WebViewOverlay::get_message_policy(const String &p_channel) const {
+	const Map<String, MessageChannel>::Element *E = message_channels.find(p_channel);
+	return E ? E->get().policy : MESSAGE_POLICY_IMMEDIATE;
+}
+
+Dictionary WebViewOverlay::get_message_stats() const {
+	Dictionary stats;
+	stats["received"] = channel_messages_received;
+	stats["emitted"] = channel_messages_emitted;
+	stats["coalesced"] = channel_messages_received - channel_messages_emitted;
+	stats["pending_channels"] = message_channels_pending;
+	return stats;
+}
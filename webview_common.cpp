@@ -3,9 +3,23 @@
 /*************************************************************************/
 
 #include "webview.h"
+#include "webview_backend.h"
+#include "webview_cache.h"
 #include "webview_icons.h"
+#include "webview_json.h"
+#include "webview_mock.h"
+#include "webview_resource.h"
+
+#include "core/message_queue.h"
+#include "core/os/os.h"
+#include "core/os/thread.h"
+#include "core/project_settings.h"
+
+// Messages of the control scripts start with the prefix and carry a JSON object.
+static const char *_message_prefix = "__webview__:";
 
 int WebViewOverlay::err_status = -1;
+bool WebViewOverlay::mock_backend = false;
 
 void WebViewOverlay::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("can_go_back"), &WebViewOverlay::can_go_back);
@@ -33,22 +47,113 @@ void WebViewOverlay::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_zoom_level", "zoom"), &WebViewOverlay::set_zoom_level);
 
 	ClassDB::bind_method(D_METHOD("load_string", "source"), &WebViewOverlay::load_string);
+	ClassDB::bind_method(D_METHOD("load_string_stream", "target", "method"), &WebViewOverlay::load_string_stream);
+	ClassDB::bind_method(D_METHOD("is_document_streaming"), &WebViewOverlay::is_document_streaming);
+	ClassDB::bind_method(D_METHOD("get_document_stream_stats"), &WebViewOverlay::get_document_stream_stats);
+	ClassDB::bind_method(D_METHOD("get_resource_cache_stats"), &WebViewOverlay::get_resource_cache_stats);
+	ClassDB::bind_method(D_METHOD("clear_resource_cache"), &WebViewOverlay::clear_resource_cache);
 	ClassDB::bind_method(D_METHOD("execute_java_script", "script"), &WebViewOverlay::execute_java_script);
+	ClassDB::bind_method(D_METHOD("send_binary", "channel", "data"), &WebViewOverlay::send_binary);
+	ClassDB::bind_method(D_METHOD("set_message_policy", "channel", "policy"), &WebViewOverlay::set_message_policy);
+	ClassDB::bind_method(D_METHOD("get_message_policy", "channel"), &WebViewOverlay::get_message_policy);
+	ClassDB::bind_method(D_METHOD("get_message_stats"), &WebViewOverlay::get_message_stats);
+	ClassDB::bind_method(D_METHOD("add_document_start_script", "name", "source"), &WebViewOverlay::add_document_start_script);
+	ClassDB::bind_method(D_METHOD("remove_document_start_script", "name"), &WebViewOverlay::remove_document_start_script);
+	ClassDB::bind_method(D_METHOD("get_document_start_scripts"), &WebViewOverlay::get_document_start_scripts);
+	ClassDB::bind_method(D_METHOD("evaluate_java_script", "script"), &WebViewOverlay::evaluate_java_script);
+	ClassDB::bind_method(D_METHOD("get_pending_evaluations"), &WebViewOverlay::get_pending_evaluations);
+	ClassDB::bind_method(D_METHOD("register_script_method", "name", "target", "method"), &WebViewOverlay::register_script_method);
+	ClassDB::bind_method(D_METHOD("unregister_script_method", "name"), &WebViewOverlay::unregister_script_method);
+	ClassDB::bind_method(D_METHOD("get_script_methods"), &WebViewOverlay::get_script_methods);
+	ClassDB::bind_method(D_METHOD("call_script_function", "function", "args", "timeout"), &WebViewOverlay::call_script_function, DEFVAL(Array()), DEFVAL(-1.0));
+	ClassDB::bind_method(D_METHOD("get_pending_script_calls"), &WebViewOverlay::get_pending_script_calls);
+	ClassDB::bind_method(D_METHOD("set_script_call_timeout", "timeout"), &WebViewOverlay::set_script_call_timeout);
+	ClassDB::bind_method(D_METHOD("get_script_call_timeout"), &WebViewOverlay::get_script_call_timeout);
+	ClassDB::bind_method(D_METHOD("get_script_call_stats"), &WebViewOverlay::get_script_call_stats);
+	ClassDB::bind_method(D_METHOD("set_shared_state", "name", "state"), &WebViewOverlay::set_shared_state);
+	ClassDB::bind_method(D_METHOD("set_shared_value", "name", "path", "value"), &WebViewOverlay::set_shared_value);
+	ClassDB::bind_method(D_METHOD("remove_shared_value", "name", "path"), &WebViewOverlay::remove_shared_value);
+	ClassDB::bind_method(D_METHOD("get_shared_state", "name"), &WebViewOverlay::get_shared_state);
+	ClassDB::bind_method(D_METHOD("remove_shared_state", "name"), &WebViewOverlay::remove_shared_state);
+	ClassDB::bind_method(D_METHOD("get_shared_state_names"), &WebViewOverlay::get_shared_state_names);
+	ClassDB::bind_method(D_METHOD("get_shared_state_stats"), &WebViewOverlay::get_shared_state_stats);
+	ClassDB::bind_method(D_METHOD("set_event_budget_usec", "usec"), &WebViewOverlay::set_event_budget_usec);
+	ClassDB::bind_method(D_METHOD("get_event_budget_usec"), &WebViewOverlay::get_event_budget_usec);
+	ClassDB::bind_method(D_METHOD("get_event_stats"), &WebViewOverlay::get_event_stats);
+	ClassDB::bind_method(D_METHOD("set_decode_messages", "enabled"), &WebViewOverlay::set_decode_messages);
+	ClassDB::bind_method(D_METHOD("is_decoding_messages"), &WebViewOverlay::is_decoding_messages);
+	ClassDB::bind_method(D_METHOD("set_script_batching", "enabled"), &WebViewOverlay::set_script_batching);
+	ClassDB::bind_method(D_METHOD("is_script_batching"), &WebViewOverlay::is_script_batching);
+	ClassDB::bind_method(D_METHOD("set_script_batch_max_size", "size"), &WebViewOverlay::set_script_batch_max_size);
+	ClassDB::bind_method(D_METHOD("get_script_batch_max_size"), &WebViewOverlay::get_script_batch_max_size);
+	ClassDB::bind_method(D_METHOD("get_script_batch_stats"), &WebViewOverlay::get_script_batch_stats);
 
 	ClassDB::bind_method(D_METHOD("get_snapshot", "width"), &WebViewOverlay::get_snapshot);
+	ClassDB::bind_method(D_METHOD("get_full_page_snapshot", "width", "tiled"), &WebViewOverlay::get_full_page_snapshot, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("is_full_page_snapshot_active"), &WebViewOverlay::is_full_page_snapshot_active);
+	ClassDB::bind_method(D_METHOD("get_texture"), &WebViewOverlay::get_texture);
+	ClassDB::bind_method(D_METHOD("set_max_snapshots_in_flight", "max"), &WebViewOverlay::set_max_snapshots_in_flight);
+	ClassDB::bind_method(D_METHOD("get_max_snapshots_in_flight"), &WebViewOverlay::get_max_snapshots_in_flight);
+	ClassDB::bind_method(D_METHOD("get_snapshot_stats"), &WebViewOverlay::get_snapshot_stats);
+	ClassDB::bind_method(D_METHOD("recycle_snapshot", "image"), &WebViewOverlay::recycle_snapshot);
+	ClassDB::bind_method(D_METHOD("clear_snapshot_pool"), &WebViewOverlay::clear_snapshot_pool);
+
+	ClassDB::bind_method(D_METHOD("set_snapshot_cache_enabled", "enabled"), &WebViewOverlay::set_snapshot_cache_enabled);
+	ClassDB::bind_method(D_METHOD("is_snapshot_cache_enabled"), &WebViewOverlay::is_snapshot_cache_enabled);
+	ClassDB::bind_method(D_METHOD("set_snapshot_fingerprint", "fingerprint"), &WebViewOverlay::set_snapshot_fingerprint);
+	ClassDB::bind_method(D_METHOD("get_snapshot_fingerprint"), &WebViewOverlay::get_snapshot_fingerprint);
+	ClassDB::bind_method(D_METHOD("get_cached_snapshot", "url", "width"), &WebViewOverlay::get_cached_snapshot);
+	ClassDB::bind_method(D_METHOD("clear_snapshot_cache"), &WebViewOverlay::clear_snapshot_cache);
+
+	ClassDB::bind_method(D_METHOD("set_streaming", "enabled"), &WebViewOverlay::set_streaming);
+	ClassDB::bind_method(D_METHOD("is_streaming"), &WebViewOverlay::is_streaming);
+	ClassDB::bind_method(D_METHOD("set_stream_fps", "fps"), &WebViewOverlay::set_stream_fps);
+	ClassDB::bind_method(D_METHOD("get_stream_fps"), &WebViewOverlay::get_stream_fps);
+	ClassDB::bind_method(D_METHOD("get_stream_dropped_frames"), &WebViewOverlay::get_stream_dropped_frames);
+
+	ClassDB::bind_method(D_METHOD("set_delta_detection", "enabled"), &WebViewOverlay::set_delta_detection);
+	ClassDB::bind_method(D_METHOD("is_delta_detection_enabled"), &WebViewOverlay::is_delta_detection_enabled);
 
 	ClassDB::bind_method(D_METHOD("get_title"), &WebViewOverlay::get_title);
 
+	ClassDB::bind_method(D_METHOD("_snapshot_ready", "id", "image", "delta"), &WebViewOverlay::_snapshot_ready, DEFVAL(Variant()));
+	ClassDB::bind_method(D_METHOD("_snapshot_failed", "id"), &WebViewOverlay::_snapshot_failed);
+	ClassDB::bind_method(D_METHOD("_wake_events"), &WebViewOverlay::_wake_events);
+	ClassDB::bind_method(D_METHOD("_rpc_completed", "result", "id"), &WebViewOverlay::_rpc_completed);
+
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "no_background"), "set_no_background", "get_no_background");
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "url"), "set_url", "get_url");
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "user_agent"), "set_user_agent", "get_user_agent");
 	ADD_PROPERTY(PropertyInfo(Variant::REAL, "zoom_level"), "set_zoom_level", "get_zoom_level");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "decode_messages"), "set_decode_messages", "is_decoding_messages");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "event_budget_usec", PROPERTY_HINT_RANGE, "0,100000,100"), "set_event_budget_usec", "get_event_budget_usec");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "delta_detection"), "set_delta_detection", "is_delta_detection_enabled");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "max_snapshots_in_flight", PROPERTY_HINT_RANGE, "1,16,1"), "set_max_snapshots_in_flight", "get_max_snapshots_in_flight");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "script_batching"), "set_script_batching", "is_script_batching");
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "script_call_timeout", PROPERTY_HINT_RANGE, "0,3600,0.1"), "set_script_call_timeout", "get_script_call_timeout");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "script_batch_max_size", PROPERTY_HINT_RANGE, "1024,16777216,1024"), "set_script_batch_max_size", "get_script_batch_max_size");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "snapshot_cache"), "set_snapshot_cache_enabled", "is_snapshot_cache_enabled");
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "snapshot_fingerprint"), "set_snapshot_fingerprint", "get_snapshot_fingerprint");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "streaming"), "set_streaming", "is_streaming");
+	ADD_PROPERTY(PropertyInfo(Variant::REAL, "stream_fps", PROPERTY_HINT_RANGE, "1,120,1"), "set_stream_fps", "get_stream_fps");
 
-	ADD_SIGNAL(MethodInfo("callback", PropertyInfo(Variant::STRING, "url")));
+	ADD_SIGNAL(MethodInfo("callback", PropertyInfo(Variant::NIL, "message", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NIL_IS_VARIANT)));
+	ADD_SIGNAL(MethodInfo("channel_message", PropertyInfo(Variant::STRING, "channel"), PropertyInfo(Variant::NIL, "message", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NIL_IS_VARIANT)));
+	ADD_SIGNAL(MethodInfo("script_evaluated", PropertyInfo(Variant::INT, "id"), PropertyInfo(Variant::NIL, "result", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NIL_IS_VARIANT), PropertyInfo(Variant::STRING, "error")));
+	ADD_SIGNAL(MethodInfo("script_call_completed", PropertyInfo(Variant::INT, "id"), PropertyInfo(Variant::NIL, "result", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NIL_IS_VARIANT), PropertyInfo(Variant::STRING, "error")));
+	ADD_SIGNAL(MethodInfo("binary_received", PropertyInfo(Variant::STRING, "channel"), PropertyInfo(Variant::POOL_BYTE_ARRAY, "data")));
+	ADD_SIGNAL(MethodInfo("document_stream_finished", PropertyInfo(Variant::STRING, "error")));
 	ADD_SIGNAL(MethodInfo("new_window", PropertyInfo(Variant::STRING, "url")));
 	ADD_SIGNAL(MethodInfo("start_navigation"));
 	ADD_SIGNAL(MethodInfo("finish_navigation"));
 	ADD_SIGNAL(MethodInfo("snapshot_ready", PropertyInfo(Variant::OBJECT, "image", PROPERTY_HINT_RESOURCE_TYPE, "Image")));
+	ADD_SIGNAL(MethodInfo("full_page_snapshot_ready", PropertyInfo(Variant::ARRAY, "images")));
+	ADD_SIGNAL(MethodInfo("snapshot_delta", PropertyInfo(Variant::OBJECT, "image", PROPERTY_HINT_RESOURCE_TYPE, "Image"), PropertyInfo(Variant::ARRAY, "rects")));
+
+	BIND_ENUM_CONSTANT(MESSAGE_POLICY_IMMEDIATE);
+	BIND_ENUM_CONSTANT(MESSAGE_POLICY_LATEST);
+	BIND_ENUM_CONSTANT(MESSAGE_POLICY_ACCUMULATE);
+	BIND_ENUM_CONSTANT(MESSAGE_POLICY_BATCH);
 }
 
 void WebViewOverlay::_draw_placeholder() {
@@ -112,3 +217,647 @@ void WebViewOverlay::_draw_error(const String &p_error) {
 	font->draw(get_canvas_item(), Vector2((size.x - er_size.x) / 2, 100 + er_size.y + 10 + ti_size.y) + Vector2(-1, -1), p_error, Color(0, 0, 0, 0.5));
 	font->draw(get_canvas_item(), Vector2((size.x - er_size.x) / 2, 100 + er_size.y + 10 + ti_size.y), p_error, Color(1, 0, 0));
 }
+
+/*************************************************************************/
+
+WebViewOverlay::WebViewOverlay() {
+	inbound_wake.store(false);
+	snapshot_pool.instance();
+	if (mock_backend) {
+		data = memnew(WebViewOverlayMock());
+	} else {
+		data = WebViewOverlayImplementation::create_native();
+	}
+	if (data != nullptr) {
+		data->control = this;
+	}
+}
+
+WebViewOverlay::~WebViewOverlay() {
+	if (data != nullptr) {
+		data->destroy();
+		memdelete(data);
+	}
+}
+
+bool WebViewOverlay::_can_queue_commands() const {
+	return (data != nullptr) && (err_status == 0) && (view_state != VIEW_STATE_FAILED) && !Engine::get_singleton()->is_editor_hint();
+}
+
+void WebViewOverlay::_queue_command(CommandType p_type, const String &p_arg, int p_width, uint64_t p_id) {
+	Command cmd;
+	cmd.type = p_type;
+	cmd.arg = p_arg;
+	cmd.width = p_width;
+	cmd.id = p_id;
+	pending_commands.push_back(cmd);
+}
+
+void WebViewOverlay::_run_command(const Command &p_command) {
+	switch (p_command.type) {
+		case COMMAND_LOAD_STRING: {
+			data->load_string(p_command.arg);
+		} break;
+		case COMMAND_EXEC_SCRIPT: {
+			data->exec_script(p_command.arg);
+		} break;
+		case COMMAND_EVALUATE_SCRIPT: {
+			ScriptEvaluation *eval = script_evaluations.get(p_command.id);
+			if (eval) {
+				eval->sent = true;
+				data->evaluate_script(p_command.arg, p_command.id);
+			}
+		} break;
+		case COMMAND_CAPTURE: {
+			data->capture(p_command.width, p_command.id);
+		} break;
+		case COMMAND_LOAD_STREAM: {
+			// Skipped if the stream was replaced or aborted in the meantime.
+			if (document_stream.active && !document_stream.started) {
+				_start_document_stream();
+			}
+		} break;
+	}
+}
+
+void WebViewOverlay::_queue_geometry_update() {
+	if (view_state == VIEW_STATE_READY) {
+		geometry_dirty = true;
+		set_process_internal(true);
+	}
+}
+
+void WebViewOverlay::_update_geometry(bool p_force) {
+	Rect2 rect;
+	if (data->is_offscreen()) {
+		rect = Rect2(Point2(), get_size());
+	} else {
+		float sc = OS::get_singleton()->get_screen_max_scale();
+		rect = get_window_rect();
+		rect.position /= sc;
+		rect.size /= sc;
+	}
+	if (p_force || (rect != view_rect)) {
+		view_rect = rect;
+		data->set_bounds(view_rect);
+	}
+
+	bool visible = is_visible_in_tree();
+	if (p_force || (visible != view_visible)) {
+		view_visible = visible;
+		data->set_visible(view_visible);
+	}
+
+	geometry_dirty = false;
+}
+
+void WebViewOverlay::_update_processing() {
+	bool needs_process = (view_state == VIEW_STATE_NONE) || (view_state == VIEW_STATE_CREATING) || geometry_dirty || streaming || full_page.active || !script_batch.empty() || (message_channels_pending > 0) || !inbound_events.is_empty() || !script_calls.empty() || !rpc_outbox_calls.empty() || !rpc_outbox_results.empty() || shared_states_dirty || (document_stream.active && document_stream.started) || data->needs_process();
+	set_process_internal(needs_process);
+}
+
+void WebViewOverlay::_notification(int p_what) {
+	switch (p_what) {
+		case NOTIFICATION_ENTER_TREE: {
+			if (!Engine::get_singleton()->is_editor_hint() && (data != nullptr) && (err_status == 0)) {
+				set_process_internal(true); // Wait for window to init, do not init in editor.
+			}
+		} break;
+		case NOTIFICATION_INTERNAL_PROCESS: {
+			if (Engine::get_singleton()->is_editor_hint() || (data == nullptr) || (err_status != 0)) {
+				break;
+			}
+			switch (view_state) {
+				case VIEW_STATE_NONE: {
+					Error err = data->create();
+					if (err == OK) {
+						view_state = VIEW_STATE_CREATING;
+					} else if (err != ERR_UNAVAILABLE) {
+						view_state = VIEW_STATE_FAILED;
+						pending_commands.clear();
+						if (document_stream.active) {
+							_finish_document_stream("View creation failed.", false);
+						}
+						_clear_snapshot_requests();
+						_cancel_script_evaluations(true);
+						_cancel_script_calls();
+						update();
+					}
+				} break;
+				case VIEW_STATE_CREATING: {
+					if (data->is_ready()) {
+						data->set_user_agent(user_agent);
+						data->set_no_background(no_background);
+						data->set_zoom_level(zoom);
+						_update_geometry(true);
+						if (!document_script_bundle.empty()) {
+							data->set_document_start_script(document_script_bundle);
+						}
+						data->navigate(home_url);
+						view_state = VIEW_STATE_READY;
+
+						while (!pending_commands.empty()) {
+							Command cmd = pending_commands.front()->get();
+							pending_commands.pop_front();
+							_run_command(cmd);
+						}
+					}
+				} break;
+				case VIEW_STATE_READY: {
+					if (geometry_dirty) {
+						_update_geometry(false);
+					}
+					_flush_script_batch();
+					if (document_stream.active && document_stream.started) {
+						_process_document_stream();
+					}
+					if (streaming) {
+						_process_stream();
+					}
+					if (full_page.active) {
+						_process_full_page();
+					}
+				} break;
+				default: {
+					//NOP
+				} break;
+			}
+			// State could have been changed in the creation callbacks, re-check before processing.
+			if ((view_state == VIEW_STATE_CREATING) || (view_state == VIEW_STATE_READY)) {
+				data->process();
+			}
+			// After backend processing, events it posted are dispatched in the same frame.
+			if (!inbound_events.is_empty()) {
+				_dispatch_events();
+			}
+			if (message_channels_pending > 0) {
+				_flush_message_channels();
+			}
+			// Script calls and results of the frame (including the ones made by the handlers above) are sent together.
+			if (view_state == VIEW_STATE_READY) {
+				_process_rpc();
+				_flush_shared_states();
+			}
+			if (view_state == VIEW_STATE_FAILED) {
+				set_process_internal(false);
+			} else {
+				_update_processing();
+			}
+		} break;
+		case NOTIFICATION_DRAW: {
+			if (err_status != 0) {
+				if (err_status == -1) {
+					_draw_error("WebView interface not initialized.");
+				} else if (mock_backend) {
+					_draw_error("Unknown error.");
+				} else {
+					_draw_error(WebViewOverlayImplementation::get_native_error(err_status));
+				}
+			} else if (view_state == VIEW_STATE_FAILED) {
+				_draw_error("Unknown control error.");
+			} else if (Engine::get_singleton()->is_editor_hint()) {
+				_draw_placeholder();
+			} else if ((data != nullptr) && data->is_offscreen()) {
+				Ref<Texture> texture = get_texture();
+				if (texture.is_valid()) {
+					draw_texture_rect(texture, Rect2(Point2(), get_size()), false);
+				}
+			}
+			_queue_geometry_update();
+		} break;
+		case NOTIFICATION_MOVED_IN_PARENT:
+		case NOTIFICATION_RESIZED:
+		case NOTIFICATION_VISIBILITY_CHANGED: {
+			_queue_geometry_update();
+		} break;
+		case NOTIFICATION_EXIT_TREE: {
+			if (document_stream.active) {
+				_finish_document_stream("View was destroyed.", true);
+			}
+			if ((data != nullptr) && data->is_created()) {
+				data->destroy();
+			}
+			inbound_events.clear();
+			_clear_snapshot_requests();
+			script_batch = String();
+			script_batch_depth = 0;
+			_cancel_script_evaluations(false);
+			_cancel_script_calls();
+			_resync_shared_states();
+			binary_outbox.clear();
+			for (Map<String, MessageChannel>::Element *E = message_channels.front(); E; E = E->next()) {
+				E->get().pending = false;
+				E->get().latest = String();
+				E->get().accumulated = Variant();
+				E->get().batch.clear();
+			}
+			message_channels_pending = 0;
+			if (view_state != VIEW_STATE_FAILED) {
+				view_state = VIEW_STATE_NONE;
+			}
+			geometry_dirty = false;
+			set_process_internal(false);
+		} break;
+		default: {
+			//NOP
+		} break;
+	}
+}
+
+void WebViewOverlay::set_no_background(bool p_bg) {
+	no_background = p_bg;
+	if (is_ready()) {
+		data->set_no_background(no_background);
+	}
+}
+
+bool WebViewOverlay::get_no_background() const {
+	return no_background;
+}
+
+void WebViewOverlay::set_url(const String &p_url) {
+	home_url = p_url;
+	if (document_stream.active) {
+		_finish_document_stream("Document stream was interrupted by navigation.", true);
+	}
+	if (is_ready()) {
+		_flush_script_batch();
+		data->navigate(home_url);
+	}
+}
+
+String WebViewOverlay::get_url() const {
+	if (is_ready()) {
+		return data->get_url();
+	}
+	return home_url;
+}
+
+void WebViewOverlay::set_user_agent(const String &p_user_agent) {
+	user_agent = p_user_agent;
+	if (is_ready()) {
+		data->set_user_agent(user_agent);
+	}
+}
+
+String WebViewOverlay::get_user_agent() const {
+	if (is_ready()) {
+		String result = data->get_user_agent();
+		if (!result.empty()) {
+			return result;
+		}
+	}
+	return user_agent;
+}
+
+double WebViewOverlay::get_zoom_level() const {
+	if (is_ready()) {
+		return data->get_zoom_level();
+	}
+	return zoom;
+}
+
+void WebViewOverlay::set_zoom_level(double p_zoom) {
+	zoom = p_zoom;
+	if (is_ready()) {
+		data->set_zoom_level(zoom);
+	}
+}
+
+String WebViewOverlay::get_title() const {
+	ERR_FAIL_COND_V(!is_ready(), "");
+	return data->get_title();
+}
+
+void WebViewOverlay::_flush_script_batch() {
+	if (script_batch.empty()) {
+		return;
+	}
+	uint64_t start = OS::get_singleton()->get_ticks_usec();
+	data->exec_script(script_batch);
+	uint64_t end = OS::get_singleton()->get_ticks_usec();
+
+	script_batch_flushes++;
+	script_batch_scripts += script_batch_depth;
+	script_batch_last_flush = end - start;
+	script_batch_max_flush = MAX(script_batch_max_flush, script_batch_last_flush);
+	script_batch_last_latency = end - script_batch_started;
+	script_batch = String();
+	script_batch_depth = 0;
+}
+
+void WebViewOverlay::execute_java_script(const String &p_script) {
+	if (is_ready() && script_batching) {
+		if (script_batch.empty()) {
+			script_batch_started = OS::get_singleton()->get_ticks_usec();
+			set_process_internal(true);
+		}
+		script_batch += _make_isolated_script(p_script);
+		script_batch_depth++;
+		if (script_batch.length() >= script_batch_max_size) {
+			_flush_script_batch();
+		}
+	} else if (is_ready()) {
+		data->exec_script(p_script);
+	} else {
+		ERR_FAIL_COND(!_can_queue_commands());
+		_queue_command(COMMAND_EXEC_SCRIPT, p_script);
+	}
+}
+
+void WebViewOverlay::set_event_budget_usec(int p_usec) {
+	ERR_FAIL_COND(p_usec < 0);
+	event_budget_usec = p_usec;
+}
+
+int WebViewOverlay::get_event_budget_usec() const {
+	return event_budget_usec;
+}
+
+Dictionary WebViewOverlay::get_event_stats() const {
+	Dictionary stats;
+	stats["queue_depth"] = inbound_events.size();
+	stats["max_depth"] = inbound_max_depth;
+	stats["dispatched"] = inbound_dispatched;
+	stats["deferred_frames"] = inbound_deferred_frames;
+	stats["last_drain_usec"] = inbound_last_drain;
+	return stats;
+}
+
+void WebViewOverlay::set_decode_messages(bool p_enabled) {
+	decode_messages = p_enabled;
+}
+
+bool WebViewOverlay::is_decoding_messages() const {
+	return decode_messages;
+}
+
+void WebViewOverlay::set_script_batching(bool p_enabled) {
+	script_batching = p_enabled;
+	if (!script_batching && is_ready()) {
+		_flush_script_batch();
+	}
+}
+
+bool WebViewOverlay::is_script_batching() const {
+	return script_batching;
+}
+
+void WebViewOverlay::set_script_batch_max_size(int p_size) {
+	ERR_FAIL_COND(p_size <= 0);
+	script_batch_max_size = p_size;
+}
+
+int WebViewOverlay::get_script_batch_max_size() const {
+	return script_batch_max_size;
+}
+
+Dictionary WebViewOverlay::get_script_batch_stats() const {
+	Dictionary stats;
+	stats["queue_depth"] = script_batch_depth;
+	stats["queue_size"] = script_batch.length();
+	stats["flushes"] = script_batch_flushes;
+	stats["scripts"] = script_batch_scripts;
+	stats["last_flush_usec"] = script_batch_last_flush;
+	stats["max_flush_usec"] = script_batch_max_flush;
+	stats["last_latency_usec"] = script_batch_last_latency;
+	return stats;
+}
+
+void WebViewOverlay::load_string(const String &p_source) {
+	if (document_stream.active) {
+		_finish_document_stream("Document stream was interrupted by navigation.", true);
+	}
+	if (is_ready()) {
+		_flush_script_batch();
+		data->load_string(p_source);
+	} else {
+		ERR_FAIL_COND(!_can_queue_commands());
+		_queue_command(COMMAND_LOAD_STRING, p_source);
+	}
+}
+
+// Script is evaluated separately from the rest of the batch, syntax errors and
+// exceptions are logged to the console. Indirect eval runs it in the global
+// scope: var and function declarations are global, let, const and class are
+// local to the evaluated script.
+String WebViewOverlay::_make_isolated_script(const String &p_script) {
+	String source = p_script.json_escape().replace(String::chr(0x2028), "\\u2028").replace(String::chr(0x2029), "\\u2029");
+	return "try{(0,eval)(\"" + source + "\");}catch(e){console.error(e);}\n";
+}
+
+String WebViewOverlay::_make_message_script(const String &p_expression) {
+	return "webviewMessage(\"" + String(_message_prefix) + "\"+JSON.stringify(" + p_expression + "));";
+}
+
+void WebViewOverlay::_post_event(InboundEventType p_type, const String &p_payload) {
+	InboundEvent event;
+	event.type = p_type;
+	event.payload = p_payload;
+	inbound_events.push(event);
+
+	if (Thread::get_caller_id() == Thread::get_main_id()) {
+		set_process_internal(true);
+	} else if (!inbound_wake.exchange(true)) {
+		// Processing can't be enabled from other threads, one wake up call is queued at a time.
+		MessageQueue::get_singleton()->push_call(get_instance_id(), "_wake_events");
+	}
+}
+
+void WebViewOverlay::_wake_events() {
+	inbound_wake.store(false);
+	if (!inbound_events.is_empty()) {
+		set_process_internal(true);
+	}
+}
+
+void WebViewOverlay::_dispatch_events() {
+	uint64_t start = OS::get_singleton()->get_ticks_usec();
+	inbound_max_depth = MAX(inbound_max_depth, inbound_events.size());
+
+	// At least one event is dispatched every frame, the rest is left for the next
+	// frames when the budget is exceeded. Handlers may clear the queue (exit tree).
+	InboundEvent event;
+	while (inbound_events.pop(event)) {
+		switch (event.type) {
+			case INBOUND_MESSAGE: {
+				_message_received(event.payload);
+			} break;
+			case INBOUND_START_NAVIGATION: {
+				binary_outbox.clear(); // Not fetched by the previous page.
+				emit_signal("start_navigation");
+			} break;
+			case INBOUND_FINISH_NAVIGATION: {
+				_resync_shared_states();
+				emit_signal("finish_navigation");
+			} break;
+			case INBOUND_NEW_WINDOW: {
+				emit_signal("new_window", event.payload);
+			} break;
+		}
+		inbound_dispatched++;
+		if ((event_budget_usec > 0) && (OS::get_singleton()->get_ticks_usec() - start >= (uint64_t)event_budget_usec)) {
+			if (!inbound_events.is_empty()) {
+				inbound_deferred_frames++;
+			}
+			break;
+		}
+	}
+	inbound_last_drain = OS::get_singleton()->get_ticks_usec() - start;
+}
+
+void WebViewOverlay::_message_received(const String &p_message) {
+	if (_is_channel_message(p_message)) {
+		_channel_message_received(p_message);
+		return;
+	}
+
+	String message = p_message;
+	if (message.begins_with("\"") && (message.begins_with("\"" + String(_message_prefix)) || decode_messages)) {
+		// Edge delivers messages JSON encoded.
+		Variant decoded;
+		if ((WebViewJSON::decode(message, decoded) == OK) && (decoded.get_type() == Variant::STRING)) {
+			message = decoded;
+		}
+	}
+	if (!message.begins_with(_message_prefix)) {
+		if (!decode_messages) {
+			emit_signal("callback", p_message);
+			return;
+		}
+		// Messages which are not valid JSON are emitted as is.
+		Variant decoded;
+		if (WebViewJSON::decode(message, decoded) == OK) {
+			emit_signal("callback", decoded);
+		} else {
+			emit_signal("callback", message);
+		}
+		return;
+	}
+
+	Variant parsed;
+	int prefix_len = strlen(_message_prefix);
+	Error err = WebViewJSON::decode(message.substr(prefix_len, message.length() - prefix_len), parsed);
+	ERR_FAIL_COND_MSG((err != OK) || (parsed.get_type() != Variant::DICTIONARY), "Invalid WebView control message.");
+
+	Dictionary msg = parsed;
+	String type = msg.get("type", String());
+	if ((type == "page_metrics") || (type == "scrolled")) {
+		_full_page_message(msg);
+	} else if (type == "rpc") {
+		_rpc_message(msg);
+	}
+}
+
+String WebViewOverlay::get_bridge_script() {
+	return _get_channel_bridge_script() + _get_binary_bridge_script() + _get_rpc_bridge_script() + _get_state_bridge_script();
+}
+
+bool WebViewOverlay::can_go_back() const {
+	ERR_FAIL_COND_V(!is_ready(), false);
+	return data->can_go_back();
+}
+
+bool WebViewOverlay::can_go_forward() const {
+	ERR_FAIL_COND_V(!is_ready(), false);
+	return data->can_go_forward();
+}
+
+bool WebViewOverlay::is_ready() const {
+	return (view_state == VIEW_STATE_READY);
+}
+
+bool WebViewOverlay::is_loading() const {
+	ERR_FAIL_COND_V(!is_ready(), false);
+	return data->is_loading();
+}
+
+bool WebViewOverlay::is_secure_content() const {
+	ERR_FAIL_COND_V(!is_ready(), false);
+	return data->is_secure_content();
+}
+
+void WebViewOverlay::go_back() {
+	ERR_FAIL_COND(!is_ready());
+	if (document_stream.active) {
+		_finish_document_stream("Document stream was interrupted by navigation.", true);
+	}
+	_flush_script_batch();
+	data->go_back();
+}
+
+void WebViewOverlay::go_forward() {
+	ERR_FAIL_COND(!is_ready());
+	if (document_stream.active) {
+		_finish_document_stream("Document stream was interrupted by navigation.", true);
+	}
+	_flush_script_batch();
+	data->go_forward();
+}
+
+void WebViewOverlay::reload() {
+	ERR_FAIL_COND(!is_ready());
+	if (document_stream.active) {
+		_finish_document_stream("Document stream was interrupted by navigation.", true);
+	}
+	_flush_script_batch();
+	data->reload();
+}
+
+void WebViewOverlay::stop() {
+	ERR_FAIL_COND(!is_ready());
+	if (document_stream.active) {
+		_finish_document_stream("Document stream was stopped.", true);
+	}
+	data->stop();
+}
+
+Dictionary WebViewOverlay::get_resource_cache_stats() const {
+	Dictionary stats;
+	stats["hits"] = WebViewResourceCache::get_hits();
+	stats["misses"] = WebViewResourceCache::get_misses();
+	stats["size"] = WebViewResourceCache::get_total_size();
+	stats["entries"] = WebViewResourceCache::get_entry_count();
+	return stats;
+}
+
+void WebViewOverlay::clear_resource_cache() {
+	WebViewResourceCache::clear();
+}
+
+void WebViewOverlay::init() {
+	GLOBAL_DEF("webview/backend", "native");
+	ProjectSettings::get_singleton()->set_custom_property_info("webview/backend", PropertyInfo(Variant::STRING, "webview/backend", PROPERTY_HINT_ENUM, "native,mock"));
+	WebViewOverlayMock::init_settings();
+	WebViewSnapshotCache::init_settings();
+	WebViewResourceCache::init_settings();
+
+	// Command line "--webview-backend <name>" overrides project setting, e.g. to run CI with the mock backend.
+	String backend = GLOBAL_GET("webview/backend");
+	List<String> args = OS::get_singleton()->get_cmdline_args();
+	for (List<String>::Element *E = args.front(); E; E = E->next()) {
+		if ((E->get() == "--webview-backend") && E->next()) {
+			backend = E->next()->get();
+		}
+	}
+
+	print_verbose(String("WebView: pixel conversion kernels: ") + WebViewPixels::get_kernel_name());
+
+	_start_snapshot_worker();
+
+	mock_backend = (backend == "mock");
+	if (mock_backend) {
+		err_status = 0;
+	} else {
+		err_status = WebViewOverlayImplementation::init_native();
+	}
+}
+
+void WebViewOverlay::finish() {
+	_stop_snapshot_worker();
+	WebViewSnapshotCache::finish();
+	WebViewResourceCache::finish();
+	if (!mock_backend) {
+		WebViewOverlayImplementation::finish_native();
+	}
+}
@@ -0,0 +1,178 @@
+/*************************************************************************/
+/*  webview_document_stream.cpp                                          */
+/*************************************************************************/
+
+#include "webview.h"
+#include "webview_backend.h"
+
+#include "core/os/os.h"
+
+/*************************************************************************/
+
+// Streamed documents are served from the local resource scheme, so the page can
+// be parsed and painted while the rest is still generated. Relative links of the
+// document resolve against the stream URL, resources should use absolute res:// URLs.
+
+uint64_t WebViewOverlay::document_stream_seq = 0;
+
+String WebViewOverlay::get_document_stream_url(uint64_t p_id) {
+	return "res://__webview_stream__/" + itos((int64_t)p_id) + ".html";
+}
+
+/*************************************************************************/
+
+// Fallback for the backends without a streaming resource handler (Edge). Whole
+// document is buffered and loaded at the end, so memory use is proportional to
+// the document size and nothing is shown before the end, only the generator
+// is still spread across frames.
+
+void WebViewOverlayImplementation::document_stream_begin(const String &p_url) {
+	document_stream_buffer.clear();
+}
+
+bool WebViewOverlayImplementation::document_stream_can_write() {
+	return true;
+}
+
+void WebViewOverlayImplementation::document_stream_write(const CharString &p_chunk) {
+	int ofs = document_stream_buffer.size();
+	document_stream_buffer.resize(ofs + p_chunk.length());
+	memcpy(document_stream_buffer.ptrw() + ofs, p_chunk.get_data(), p_chunk.length());
+}
+
+void WebViewOverlayImplementation::document_stream_end() {
+	String source;
+	source.parse_utf8((const char *)document_stream_buffer.ptr(), document_stream_buffer.size());
+	document_stream_buffer.clear();
+	load_string(source);
+	control->_document_stream_done();
+}
+
+void WebViewOverlayImplementation::document_stream_abort() {
+	document_stream_buffer.clear();
+}
+
+/*************************************************************************/
+
+Error WebViewOverlay::load_string_stream(Object *p_target, const StringName &p_method) {
+	ERR_FAIL_NULL_V(p_target, ERR_INVALID_PARAMETER);
+	ERR_FAIL_COND_V(!is_ready() && !_can_queue_commands(), ERR_UNCONFIGURED);
+
+	if (document_stream.active) {
+		_finish_document_stream("Document stream was replaced.", true);
+	}
+	document_stream = DocumentStream();
+	document_stream.active = true;
+	document_stream.target = p_target->get_instance_id();
+	document_stream.method = p_method;
+
+	if (is_ready()) {
+		_start_document_stream();
+	} else {
+		_queue_command(COMMAND_LOAD_STREAM);
+	}
+	return OK;
+}
+
+bool WebViewOverlay::is_document_streaming() const {
+	return document_stream.active;
+}
+
+Dictionary WebViewOverlay::get_document_stream_stats() const {
+	Dictionary stats;
+	stats["active"] = document_stream.active;
+	stats["chunks"] = document_stream.chunks;
+	stats["bytes"] = document_stream.bytes;
+	stats["max_chunk"] = document_stream_max_chunk;
+	stats["finished"] = document_streams_finished;
+	stats["aborted"] = document_streams_aborted;
+	return stats;
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::_start_document_stream() {
+	_flush_script_batch();
+	document_stream.started = true;
+	data->document_stream_begin(get_document_stream_url(++document_stream_seq));
+	set_process_internal(true);
+}
+
+void WebViewOverlay::_finish_document_stream(const String &p_error, bool p_abort_backend) {
+	bool started = document_stream.started;
+	document_stream.active = false;
+	document_stream.started = false;
+	document_stream.ending = false;
+	if (p_error.empty()) {
+		document_streams_finished++;
+	} else {
+		document_streams_aborted++;
+		if (started && p_abort_backend) {
+			data->document_stream_abort();
+		}
+	}
+	emit_signal("document_stream_finished", p_error);
+}
+
+void WebViewOverlay::_process_document_stream() {
+	if (document_stream.ending) {
+		return; // Backend reports when the rest is delivered.
+	}
+	uint64_t start = OS::get_singleton()->get_ticks_usec();
+
+	// Generator is called only when the backend has consumed the previous chunk,
+	// at least once per frame and then until the budget is exceeded.
+	while (data->document_stream_can_write()) {
+		Object *target = ObjectDB::get_instance(document_stream.target);
+		if (!target) {
+			_finish_document_stream("Document stream generator was freed.", true);
+			return;
+		}
+
+		Variant index = document_stream.chunks;
+		const Variant *args[1] = { &index };
+		Variant::CallError ce;
+		Variant chunk = target->call(document_stream.method, args, 1, ce);
+		if (!document_stream.active) {
+			return; // Generator navigated or started another stream.
+		}
+		if (ce.error != Variant::CallError::CALL_OK) {
+			_finish_document_stream(Variant::get_call_error_text(target, document_stream.method, args, 1, ce), true);
+			return;
+		}
+
+		// Null or empty string ends the document, stream is finished when the
+		// backend delivers the chunks it still buffers.
+		if ((chunk.get_type() == Variant::NIL) || ((chunk.get_type() == Variant::STRING) && String(chunk).empty())) {
+			document_stream.ending = true;
+			data->document_stream_end();
+			return;
+		}
+		if (chunk.get_type() != Variant::STRING) {
+			_finish_document_stream("Document stream generator must return a String.", true);
+			return;
+		}
+
+		CharString utf8 = String(chunk).utf8();
+		document_stream.chunks++;
+		document_stream.bytes += utf8.length();
+		document_stream_max_chunk = MAX(document_stream_max_chunk, (uint64_t)utf8.length());
+		data->document_stream_write(utf8);
+
+		if (OS::get_singleton()->get_ticks_usec() - start >= (uint64_t)DOCUMENT_STREAM_BUDGET_USEC) {
+			break;
+		}
+	}
+}
+
+void WebViewOverlay::_document_stream_done() {
+	if (document_stream.active && document_stream.ending) {
+		_finish_document_stream(String(), false);
+	}
+}
+
+void WebViewOverlay::_document_stream_closed() {
+	if (document_stream.active && document_stream.started) {
+		_finish_document_stream("Document stream was closed by the view.", false);
+	}
+}
@@ -2,7 +2,7 @@
 /*  webview_edge.cpp                                                     */
 /*************************************************************************/
 
-#include "webview.h"
+#include "webview_backend.h"
 #include "core/os/os.h"
 
 #include <shlwapi.h>
@@ -15,9 +15,33 @@ using namespace Microsoft::WRL;
 typedef HRESULT (WINAPI *CreateCoreWebView2EnvironmentWithOptionsPtr)(PCWSTR p_browser_executable_folder, PCWSTR p_user_data_folder, ICoreWebView2EnvironmentOptions* p_environment_options, ICoreWebView2CreateCoreWebView2EnvironmentCompletedHandler* r_environment_created_handler);
 CreateCoreWebView2EnvironmentWithOptionsPtr webview_CreateCoreWebView2EnvironmentWithOptions = nullptr;
 
+// Snapshot PNG is decoded on the snapshot worker thread directly from the stream memory, stream is kept alive until then.
+class WebViewPNGSnapshotSource : public WebViewSnapshotSource {
+public:
+	ComPtr<IStream> stream;
+	HGLOBAL hg = nullptr;
+	const uint8_t *ptr = nullptr;
+
+	virtual const uint8_t *lock() {
+		STATSTG stats;
+		stream->Stat(&stats, STATFLAG_NONAME);
+		size = stats.cbSize.QuadPart;
+
+		ptr = (const uint8_t *)GlobalLock(hg);
+		return ptr;
+	}
+
+	virtual ~WebViewPNGSnapshotSource() {
+		if (ptr != nullptr) {
+			GlobalUnlock(hg);
+		}
+	}
+};
+
 class WebViewOverlaySnapshotDelegate : public ICoreWebView2CapturePreviewCompletedHandler {
 public:
 	WebViewOverlay *control = nullptr;
+	uint64_t id = 0;
 	ComPtr<IStream> img_data_stream = nullptr;
 	LONG _cRef = 1;
 
@@ -40,32 +64,109 @@ public:
 	}
 
 	HRESULT STDMETHODCALLTYPE Invoke(HRESULT p_error_code) {
-		STATSTG stats;
-		img_data_stream->Stat(&stats, STATFLAG_NONAME);
-		ULONG size = stats.cbSize.QuadPart;
-		ULONG bytes_read;
+		// CapturePreview supports PNG and JPEG only.
+		HGLOBAL hg = nullptr;
+		if (FAILED(p_error_code) || FAILED(GetHGlobalFromStream(img_data_stream.Get(), &hg))) {
+			control->_snapshot_failed(id);
+			return S_OK;
+		}
 
-		PoolVector<uint8_t> imgdata;
-		imgdata.resize(size);
-		PoolVector<uint8_t>::Write wr = imgdata.write();
+		WebViewPNGSnapshotSource *source = memnew(WebViewPNGSnapshotSource);
+		source->type = WebViewSnapshotSource::TYPE_PNG;
+		source->stream = img_data_stream;
+		source->hg = hg;
+		control->_snapshot_ready_source(id, source);
 
-		LARGE_INTEGER li;
-		li.QuadPart = 0;
-		img_data_stream->Seek(li, STREAM_SEEK_SET, nullptr);
-		img_data_stream->Read(wr.ptr(), size, &bytes_read);
+		return S_OK;
+	}
+
+	WebViewOverlaySnapshotDelegate(WebViewOverlay* p_control, uint64_t p_id) {
+		control = p_control;
+		id = p_id;
+		CreateStreamOnHGlobal(nullptr, TRUE, &img_data_stream);
+	}
+};
+
+// Control is resolved when the result arrives, it can be freed while the script is running.
+class WebViewOverlayScriptDelegate : public ICoreWebView2ExecuteScriptCompletedHandler {
+public:
+	ObjectID control_id = 0;
+	uint64_t id = 0;
+	LONG _cRef = 1;
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return InterlockedIncrement(&_cRef);
+	}
 
-		Ref<Image> image;
-		image.instance();
-		image->load_png_from_buffer(imgdata);
+	ULONG STDMETHODCALLTYPE Release() {
+		ULONG ulRef = InterlockedDecrement(&_cRef);
+		if (0 == ulRef) {
+			delete this;
+		}
+		return ulRef;
+	}
 
-		control->emit_signal("snapshot_ready", image);
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, VOID **ppvInterface) {
+		AddRef();
+		*ppvInterface = this;
+		return S_OK;
+	}
 
+	HRESULT STDMETHODCALLTYPE Invoke(HRESULT p_error_code, LPCWSTR p_result) {
+		WebViewOverlay *control = Object::cast_to<WebViewOverlay>(ObjectDB::get_instance(control_id));
+		if (!control) {
+			return S_OK;
+		}
+		// Result is JSON encoded, "null" if script throws or returns undefined.
+		if (FAILED(p_error_code) || (p_result == nullptr)) {
+			control->_script_failed(id, "Script execution failed.");
+		} else {
+			control->_script_evaluated_json(id, String(p_result));
+		}
 		return S_OK;
 	}
 
-	WebViewOverlaySnapshotDelegate(WebViewOverlay* p_control) {
-		control = p_control;
-		img_data_stream = SHCreateMemStream(nullptr, 0);
+	WebViewOverlayScriptDelegate(WebViewOverlay *p_control, uint64_t p_id) {
+		control_id = p_control->get_instance_id();
+		id = p_id;
+	}
+};
+
+/*************************************************************************/
+
+class WebViewOverlayDelegate;
+
+// Receives the id of the user document-start script, needed to remove it.
+// Owner is cleared if the view is destroyed before the script is added.
+class WebViewOverlayStartScriptDelegate : public ICoreWebView2AddScriptToExecuteOnDocumentCreatedCompletedHandler {
+public:
+	WebViewOverlayDelegate *owner = nullptr;
+	uint64_t serial = 0;
+	LONG _cRef = 1;
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return InterlockedIncrement(&_cRef);
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		ULONG ulRef = InterlockedDecrement(&_cRef);
+		if (0 == ulRef) {
+			delete this;
+		}
+		return ulRef;
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, VOID **ppvInterface) {
+		AddRef();
+		*ppvInterface = this;
+		return S_OK;
+	}
+
+	HRESULT STDMETHODCALLTYPE Invoke(HRESULT p_error_code, LPCWSTR p_id);
+
+	WebViewOverlayStartScriptDelegate(WebViewOverlayDelegate *p_owner, uint64_t p_serial) {
+		owner = p_owner;
+		serial = p_serial;
 	}
 };
 
@@ -77,6 +178,7 @@ class WebViewOverlayDelegate :
 	public ICoreWebView2NavigationCompletedEventHandler,
 	public ICoreWebView2NewWindowRequestedEventHandler,
 	public ICoreWebView2WebMessageReceivedEventHandler,
+	public ICoreWebView2WebResourceRequestedEventHandler,
 	public ICoreWebView2AddScriptToExecuteOnDocumentCreatedCompletedHandler,
 	public ICoreWebView2CreateCoreWebView2EnvironmentCompletedHandler {
 public:
@@ -96,6 +198,12 @@ public:
 	EventRegistrationToken navigation_completed_token = {};
 	EventRegistrationToken new_window_token = {};
 	EventRegistrationToken message_token = {};
+	EventRegistrationToken resource_token = {};
+
+	// User document-start script, replaced scripts are removed by id.
+	String start_script_id;
+	uint64_t start_script_serial = 0;
+	List<WebViewOverlayStartScriptDelegate *> start_script_requests;
 
 	ULONG STDMETHODCALLTYPE AddRef() {
 		return InterlockedIncrement(&_cRef);
@@ -117,7 +225,7 @@ public:
 
 	HRESULT STDMETHODCALLTYPE Invoke(ICoreWebView2* p_sender, ICoreWebView2NavigationStartingEventArgs* p_args) {
 		if (control != nullptr) {
-			control->emit_signal("start_navigation");
+			control->_post_event(WebViewOverlay::INBOUND_START_NAVIGATION);
 		}
 		is_loading = true;
 		return S_OK;
@@ -125,7 +233,7 @@ public:
 
 	HRESULT STDMETHODCALLTYPE Invoke(ICoreWebView2* p_sender, ICoreWebView2NavigationCompletedEventArgs* p_args) {
 		if (control != nullptr) {
-			control->emit_signal("finish_navigation");
+			control->_post_event(WebViewOverlay::INBOUND_FINISH_NAVIGATION);
 		}
 		is_loading = false;
 		return S_OK;
@@ -137,7 +245,7 @@ public:
 		ERR_FAIL_COND_V(uri == nullptr, S_OK);
 		String result = String(uri);
 
-		control->emit_signal("new_window", result);
+		control->_post_event(WebViewOverlay::INBOUND_NEW_WINDOW, result);
 		return S_OK;
 	}
 
@@ -158,8 +266,11 @@ public:
 		webview->add_NavigationCompleted(this, &navigation_completed_token);
 		webview->add_NewWindowRequested(this, &new_window_token);
 		webview->add_WebMessageReceived(this, &message_token);
+		webview->AddWebResourceRequestedFilter(L"https://webview-bin.invalid/*", COREWEBVIEW2_WEB_RESOURCE_CONTEXT_ALL);
+		webview->add_WebResourceRequested(this, &resource_token);
 
-		webview->AddScriptToExecuteOnDocumentCreated(L"function webviewMessage(s){window.chrome.callback.postMessage(s);}", this);
+		String bridge = "function webviewMessage(s){window.chrome.webview.postMessage(s);}" + control->_get_binary_endpoint_script() + WebViewOverlay::get_bridge_script();
+		webview->AddScriptToExecuteOnDocumentCreated((LPCWSTR)bridge.c_str(), this);
 
 		is_ready = true;
 
@@ -172,10 +283,77 @@ public:
 	}
 
 	HRESULT STDMETHODCALLTYPE Invoke(ICoreWebView2 *p_sender, ICoreWebView2WebMessageReceivedEventArgs *p_args) {
+		// Bridge messages ("__webview_*" prefix) are taken as is, channel messages are
+		// routed without decoding.
+		LPWSTR str = nullptr;
+		if (SUCCEEDED(p_args->TryGetWebMessageAsString(&str)) && (str != nullptr)) {
+			bool bridge = (wcsncmp(str, L"__webview_", 10) == 0);
+			if (bridge) {
+				control->_post_event(WebViewOverlay::INBOUND_MESSAGE, String(str));
+			}
+			CoTaskMemFree(str);
+			if (bridge) {
+				return S_OK;
+			}
+		}
+
 		LPWSTR json;
 		p_args->get_WebMessageAsJson(&json);
 
-		control->emit_signal("callback", String(json));
+		control->_post_event(WebViewOverlay::INBOUND_MESSAGE, String(json));
+		return S_OK;
+	}
+
+	// Binary endpoint requests never reach the network, they are answered here.
+	HRESULT STDMETHODCALLTYPE Invoke(ICoreWebView2 *p_sender, ICoreWebView2WebResourceRequestedEventArgs *p_args) {
+		ComPtr<ICoreWebView2WebResourceRequest> request;
+		LPWSTR uri = nullptr;
+		if (FAILED(p_args->get_Request(&request)) || FAILED(request->get_Uri(&uri)) || (uri == nullptr)) {
+			return S_OK;
+		}
+		String path = String(uri).trim_prefix("https://webview-bin.invalid/");
+		CoTaskMemFree(uri);
+		int end = path.find_char('?');
+		if (end != -1) {
+			path = path.substr(0, end);
+		}
+
+		// Body is read once, directly to the payload passed to the signal.
+		PoolByteArray body;
+		ComPtr<IStream> content;
+		if (SUCCEEDED(request->get_Content(&content)) && content) {
+			int size = 0;
+			while (size <= WebViewOverlay::MAX_BINARY_TRANSFER_SIZE) { // Larger body is refused.
+				body.resize(size + 65536);
+				ULONG len = 0;
+				HRESULT hr;
+				{
+					PoolByteArray::Write w = body.write();
+					hr = content->Read(w.ptr() + size, 65536, &len);
+				}
+				size += len;
+				if (FAILED(hr) || (len == 0)) {
+					break;
+				}
+			}
+			body.resize(size);
+		}
+
+		PoolByteArray payload;
+		int status = WebViewOverlay::_binary_request(path, body, payload);
+		IStream *stream;
+		{
+			PoolByteArray::Read r = payload.read();
+			stream = SHCreateMemStream(r.ptr(), payload.size());
+		}
+		ComPtr<ICoreWebView2WebResourceResponse> response;
+		HRESULT hr = env->CreateWebResourceResponse(stream, status, (status == 200) ? L"OK" : L"Error", L"Access-Control-Allow-Origin: *\nContent-Type: application/octet-stream", &response);
+		if (stream) {
+			stream->Release();
+		}
+		if (SUCCEEDED(hr)) {
+			p_args->put_Response(response.Get());
+		}
 		return S_OK;
 	}
 
@@ -192,281 +370,237 @@ public:
 	}
 
 	~WebViewOverlayDelegate() {
+		for (List<WebViewOverlayStartScriptDelegate *>::Element *E = start_script_requests.front(); E; E = E->next()) {
+			E->get()->owner = nullptr;
+			E->get()->Release();
+		}
 		if (webview) {
 			webview->remove_NavigationCompleted(navigation_completed_token);
 			webview->remove_NavigationStarting(navigation_start_token);
 			webview->remove_NewWindowRequested(new_window_token);
 			webview->remove_WebMessageReceived(message_token);
+			webview->remove_WebResourceRequested(resource_token);
 		}
 	}
 };
 
+HRESULT STDMETHODCALLTYPE WebViewOverlayStartScriptDelegate::Invoke(HRESULT p_error_code, LPCWSTR p_id) {
+	if (owner == nullptr) {
+		return S_OK; // View was destroyed.
+	}
+	if (SUCCEEDED(p_error_code) && (p_id != nullptr)) {
+		if (serial == owner->start_script_serial) {
+			owner->start_script_id = String(p_id);
+		} else {
+			owner->webview->RemoveScriptToExecuteOnDocumentCreated(p_id); // Replaced before it was added.
+		}
+	}
+	owner->start_script_requests.erase(this);
+	owner = nullptr;
+	Release();
+	return S_OK;
+}
+
 /*************************************************************************/
 
-class WebViewOverlayImplementation {
+class WebViewOverlayEdge : public WebViewOverlayImplementation {
 public:
 	WebViewOverlayDelegate *view = nullptr;
-};
 
-/*************************************************************************/
+	virtual Error create() {
+		HWND hwnd = (HWND)OS::get_singleton()->get_native_handle(OS::WINDOW_HANDLE);
+		if (hwnd == nullptr) {
+			return ERR_UNAVAILABLE;
+		}
+		view = new WebViewOverlayDelegate(control, hwnd);
+		return OK;
+	}
 
-WebViewOverlay::WebViewOverlay() {
-	data = memnew(WebViewOverlayImplementation());
-}
+	virtual void destroy() {
+		if (view != nullptr) {
+			delete view;
+			view = nullptr;
+		}
+	}
 
-WebViewOverlay::~WebViewOverlay() {
-	memdelete(data);
-}
+	virtual bool is_created() const {
+		return (view != nullptr);
+	}
 
-void WebViewOverlay::_notification(int p_what) {
-	switch (p_what) {
-		case NOTIFICATION_ENTER_TREE: {
-			if (!Engine::get_singleton()->is_editor_hint() && (err_status == 0)) {
-				set_process_internal(true); // Wait for window to init, do not init in editor.
-			}
-		} break;
-		case NOTIFICATION_INTERNAL_PROCESS: {
-			if (!Engine::get_singleton()->is_editor_hint() && (data->view == nullptr) && (err_status == 0)) {
-				HWND hwnd = (HWND)OS::get_singleton()->get_native_handle(OS::WINDOW_HANDLE);
-				if (hwnd != nullptr) {
-					float sc = OS::get_singleton()->get_screen_max_scale();
-					Rect2i rect = get_window_rect();
-					WebViewOverlayDelegate *webview = new WebViewOverlayDelegate(this, hwnd);
-					data->view = webview;
-					ctrl_err_status = -1;
-				}
-			}
-			if (!Engine::get_singleton()->is_editor_hint() && (data->view != nullptr) && (data->view->is_ready) && (ctrl_err_status == -1) && (err_status == 0)) {
-				float sc = OS::get_singleton()->get_screen_max_scale();
-				Rect2i rect = get_window_rect();
+	virtual String get_binary_endpoint() const {
+		return "https://webview-bin.invalid/";
+	}
 
-				if (user_agent.length() > 0) {
-					//TODO - available in unreleased ICoreWebView2ExperimentalSettings only
-				}
-				//set (no_background) TODO, add WM_PAINT handler with SetBkMode(hdc, TRANSPARENT);
-
-				RECT rc;
-				rc.left = rect.position.x / sc;
-				rc.top = rect.position.y / sc;
-				rc.right = rc.left + rect.size.width / sc;
-				rc.bottom = rc.top + rect.size.height / sc;
-
-				data->view->controller->put_Bounds(rc);
-				data->view->controller->put_ZoomFactor(zoom);
-				if (is_visible_in_tree()) {
-					data->view->controller->put_IsVisible(TRUE);
-				} else {
-					data->view->controller->put_IsVisible(FALSE);
-				}
+	virtual bool is_ready() const {
+		return (view != nullptr) && view->is_ready;
+	}
 
-				data->view->webview->Navigate((LPCWSTR)home_url.c_str());
-				ctrl_err_status = 0;
+	virtual void set_bounds(const Rect2 &p_rect) {
+		RECT rc;
+		rc.left = p_rect.position.x;
+		rc.top = p_rect.position.y;
+		rc.right = rc.left + p_rect.size.width;
+		rc.bottom = rc.top + p_rect.size.height;
+		view->controller->put_Bounds(rc);
+	}
 
-				set_process_internal(false);
-			}
-		} break;
-		case NOTIFICATION_DRAW: {
-			if (err_status != 0) {
-				switch (err_status) {
-					case -1: {
-						_draw_error("WebView interface no initialized.");
-					} break;
-					case 1: {
-						_draw_error("Failed to load 'WebView2Loader.dll' library.");
-					} break;
-					case 2: {
-						_draw_error("'CreateCoreWebView2EnvironmentWithOptions' function not found.");
-					} break;
-					default: {
-						_draw_error("Unknown error.");
-					} break;
-				};
-			} else if (ctrl_err_status > 0) {
-				_draw_error("Unknown control error.");
-			} else if (Engine::get_singleton()->is_editor_hint()) {
-				_draw_placeholder();
-			}
-		} FALLTHROUGH;
-		case NOTIFICATION_MOVED_IN_PARENT:
-		case NOTIFICATION_RESIZED: {
-			if ((data->view != nullptr) && (data->view->is_ready)) {
-				float sc = OS::get_singleton()->get_screen_max_scale();
-				Rect2i rect = get_window_rect();
-
-				RECT rc;
-				rc.left = rect.position.x / sc;
-				rc.top = rect.position.y / sc;
-				rc.right = rc.left + rect.size.width / sc;
-				rc.bottom = rc.top + rect.size.height / sc;
-				data->view->controller->put_Bounds(rc);
-			}
-		} break;
-		case NOTIFICATION_VISIBILITY_CHANGED: {
-			if ((data->view != nullptr) && (data->view->is_ready)) {
-				if (is_visible_in_tree()) {
-					data->view->controller->put_IsVisible(TRUE);
-				} else {
-					data->view->controller->put_IsVisible(FALSE);
-				}
-			}
-		} break;
-		case NOTIFICATION_EXIT_TREE: {
-			if (data->view != nullptr) {
-				delete data->view;
-				data->view = nullptr;
-			}
-		} break;
-		default: {
-			//NOP
-		} break;
+	virtual void set_visible(bool p_visible) {
+		view->controller->put_IsVisible((p_visible) ? TRUE : FALSE);
 	}
-}
 
-void WebViewOverlay::get_snapshot(int p_width) {
-	ERR_FAIL_COND(data->view == nullptr || !data->view->is_ready);
+	virtual void set_no_background(bool p_bg) {
+		//TODO, add WM_PAINT handler with SetBkMode(hdc, TRANSPARENT);
+	}
 
-	ComPtr<WebViewOverlaySnapshotDelegate> del = new WebViewOverlaySnapshotDelegate(this);
-	data->view->webview->CapturePreview(COREWEBVIEW2_CAPTURE_PREVIEW_IMAGE_FORMAT_PNG, del->img_data_stream.Get(), del.Get());
-}
+	virtual void set_user_agent(const String &p_user_agent) {
+		//TODO - available in unreleased ICoreWebView2ExperimentalSettings only
+	}
 
-void WebViewOverlay::set_no_background(bool p_bg) {
-	no_background = p_bg;
-	//TODO
-}
+	virtual String get_user_agent() const {
+		//TODO
+		return String();
+	}
 
-bool WebViewOverlay::get_no_background() const {
-	return no_background;
-}
+	virtual void set_zoom_level(double p_zoom) {
+		view->controller->put_ZoomFactor(p_zoom);
+	}
+
+	virtual double get_zoom_level() const {
+		double _zoom;
+		view->controller->get_ZoomFactor(&_zoom);
+		return _zoom;
+	}
 
-void WebViewOverlay::set_url(const String& p_url) {
-	home_url = p_url;
-	if ((data->view != nullptr) && (data->view->is_ready)) {
-		data->view->webview->Navigate((LPCWSTR)p_url.c_str());
+	virtual void navigate(const String &p_url) {
+		view->webview->Navigate((LPCWSTR)p_url.c_str());
 	}
-}
 
-String WebViewOverlay::get_url() const {
-	if ((data->view != nullptr) && (data->view->is_ready)) {
+	virtual String get_url() const {
 		LPWSTR uri;
-		data->view->webview->get_Source(&uri);
+		view->webview->get_Source(&uri);
 		ERR_FAIL_COND_V(uri == nullptr, "");
 
-		String result = String(uri);
-		return result;
+		return String(uri);
 	}
 
-	return home_url;
-}
-
-void WebViewOverlay::set_user_agent(const String& p_user_agent) {
-	user_agent = p_user_agent;
-	//TODO
-}
+	virtual String get_title() const {
+		LPWSTR title;
+		view->webview->get_DocumentTitle(&title);
+		ERR_FAIL_COND_V(title == nullptr, "");
 
-String WebViewOverlay::get_user_agent() const {
-	//TODO
-	return user_agent;
-}
-
-double WebViewOverlay::get_zoom_level() const {
-	if ((data->view != nullptr) && (data->view->is_ready)) {
-		double _zoom;
-		data->view->controller->get_ZoomFactor(&_zoom);
-		return _zoom;
+		return String(title);
 	}
-	return zoom;
-}
 
-void WebViewOverlay::set_zoom_level(double p_zoom) {
-	zoom = p_zoom;
-	if ((data->view != nullptr) && (data->view->is_ready)) {
-		data->view->controller->put_ZoomFactor(zoom);
+	virtual void load_string(const String &p_source) {
+		view->webview->NavigateToString((LPCWSTR)p_source.c_str());
 	}
-}
-
-String WebViewOverlay::get_title() const {
-	ERR_FAIL_COND_V(data->view == nullptr, "");
-	
-	LPWSTR title;
-	data->view->webview->get_DocumentTitle(&title);
-	ERR_FAIL_COND_V(title == nullptr, "");
-	String result = String(title);
 
-	return result;
-}
+	virtual void exec_script(const String &p_script) {
+		view->webview->ExecuteScript((LPCWSTR)p_script.c_str(), nullptr);
+	}
 
-void WebViewOverlay::execute_java_script(const String &p_script) {
-	ERR_FAIL_COND(data->view == nullptr || !data->view->is_ready);
+	virtual void set_document_start_script(const String &p_source) {
+		if (!view->start_script_id.empty()) {
+			view->webview->RemoveScriptToExecuteOnDocumentCreated((LPCWSTR)view->start_script_id.c_str());
+			view->start_script_id = String();
+		}
+		view->start_script_serial++;
+		if (p_source.empty()) {
+			return;
+		}
+		WebViewOverlayStartScriptDelegate *del = new WebViewOverlayStartScriptDelegate(view, view->start_script_serial);
+		view->start_script_requests.push_back(del);
+		HRESULT hr = view->webview->AddScriptToExecuteOnDocumentCreated((LPCWSTR)p_source.c_str(), del);
+		if (FAILED(hr)) {
+			view->start_script_requests.erase(del);
+			del->Release();
+			ERR_FAIL_MSG("Can't add document-start script.");
+		}
+	}
 
-	data->view->webview->ExecuteScript((LPCWSTR)p_script.c_str(), nullptr);
-}
+	virtual void evaluate_script(const String &p_script, uint64_t p_id) {
+		ComPtr<WebViewOverlayScriptDelegate> del = new WebViewOverlayScriptDelegate(control, p_id);
+		HRESULT hr = view->webview->ExecuteScript((LPCWSTR)p_script.c_str(), del.Get());
+		if (FAILED(hr)) {
+			control->_script_failed(p_id, "Script execution failed.");
+		}
+	}
 
-void WebViewOverlay::load_string(const String &p_source) {
-	ERR_FAIL_COND(data->view == nullptr || !data->view->is_ready);
-	data->view->webview->NavigateToString((LPCWSTR)p_source.c_str());
-}
+	virtual void capture(int p_width, uint64_t p_id) {
+		ComPtr<WebViewOverlaySnapshotDelegate> del = new WebViewOverlaySnapshotDelegate(control, p_id);
+		view->webview->CapturePreview(COREWEBVIEW2_CAPTURE_PREVIEW_IMAGE_FORMAT_PNG, del->img_data_stream.Get(), del.Get());
+	}
 
-bool WebViewOverlay::can_go_back() const {
-	ERR_FAIL_COND_V(data->view == nullptr, false);
-	BOOL result = false;
-	data->view->webview->get_CanGoBack(&result);
-	return result;
-}
+	virtual bool can_go_back() const {
+		BOOL result = false;
+		view->webview->get_CanGoBack(&result);
+		return result;
+	}
 
-bool WebViewOverlay::can_go_forward() const {
-	ERR_FAIL_COND_V(data->view == nullptr, false);
-	BOOL result = false;
-	data->view->webview->get_CanGoForward(&result);
-	return result;
-}
+	virtual bool can_go_forward() const {
+		BOOL result = false;
+		view->webview->get_CanGoForward(&result);
+		return result;
+	}
 
-bool WebViewOverlay::is_ready() const {
-	return (data->view != nullptr) && data->view->is_ready;
-}
+	virtual bool is_loading() const {
+		return view->is_loading;
+	}
 
-bool WebViewOverlay::is_loading() const {
-	ERR_FAIL_COND_V(data->view == nullptr, false);
-	return data->view->is_loading;
-}
+	virtual bool is_secure_content() const {
+		//TODO not supported ???
+		return false;
+	}
 
-bool WebViewOverlay::is_secure_content() const {
-	ERR_FAIL_COND_V(data->view == nullptr, false);
-	//TODO not supported ???
-	return false;
-}
+	virtual void go_back() {
+		view->webview->GoBack();
+	}
 
-void WebViewOverlay::go_back() {
-	ERR_FAIL_COND(data->view == nullptr || !data->view->is_ready);
-	data->view->webview->GoBack();
-}
+	virtual void go_forward() {
+		view->webview->GoForward();
+	}
 
-void WebViewOverlay::go_forward() {
-	ERR_FAIL_COND(data->view == nullptr || !data->view->is_ready);
-	data->view->webview->GoForward();
-}
+	virtual void reload() {
+		view->webview->Reload();
+	}
 
-void WebViewOverlay::reload() {
-	ERR_FAIL_COND(data->view == nullptr || !data->view->is_ready);
-	data->view->webview->Reload();
-}
+	virtual void stop() {
+		view->webview->Stop();
+	}
+};
 
-void WebViewOverlay::stop() {
-	ERR_FAIL_COND(data->view == nullptr || !data->view->is_ready);
-	data->view->webview->Stop();
-}
+/*************************************************************************/
 
-void WebViewOverlay::init() {
+int WebViewOverlayImplementation::init_native() {
 	HMODULE wv2_lib = LoadLibraryW(L"WebView2Loader.dll");
 	if (wv2_lib) {
 		webview_CreateCoreWebView2EnvironmentWithOptions = (CreateCoreWebView2EnvironmentWithOptionsPtr)GetProcAddress(wv2_lib, "CreateCoreWebView2EnvironmentWithOptions");
 		if (webview_CreateCoreWebView2EnvironmentWithOptions != nullptr) {
-			err_status = 0;
+			return 0;
 		} else {
-			err_status = 2;
+			return 2;
 		}
 	} else {
-		err_status = 1;
+		return 1;
 	}
 }
 
-void WebViewOverlay::finish() {}
\ No newline at end of file
+void WebViewOverlayImplementation::finish_native() {}
+
+String WebViewOverlayImplementation::get_native_error(int p_status) {
+	switch (p_status) {
+		case 1: {
+			return "Failed to load 'WebView2Loader.dll' library.";
+		} break;
+		case 2: {
+			return "'CreateCoreWebView2EnvironmentWithOptions' function not found.";
+		} break;
+		default: {
+			return "Unknown error.";
+		} break;
+	};
+}
+
+WebViewOverlayImplementation *WebViewOverlayImplementation::create_native() {
+	return memnew(WebViewOverlayEdge());
+}
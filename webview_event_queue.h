@@ -0,0 +1,134 @@
+/*************************************************************************/
+/*  webview_event_queue.h                                                */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_EVENT_QUEUE_H
+#define WEB_VIEW_EVENT_QUEUE_H
+
+#include "core/list.h"
+#include "core/os/memory.h"
+#include "core/os/mutex.h"
+
+#include <atomic>
+
+/*************************************************************************/
+
+// Bounded multi-producer single-consumer queue. Producers claim ring cells with
+// a compare-and-swap on the head, each cell carries a sequence number which
+// tells the consumer when its value is published, so push and pop do not lock.
+//
+// When the ring is full, values go to a locked overflow list until the consumer
+// drains it, order of the values pushed by one producer is kept.
+template <class T>
+class WebViewEventQueue {
+	struct Cell {
+		std::atomic<uint32_t> seq;
+		T value;
+	};
+
+	Cell *cells = nullptr;
+	uint32_t mask = 0;
+	std::atomic<uint32_t> head;
+	uint32_t tail = 0; // Consumer only.
+
+	Mutex overflow_mutex;
+	List<T> overflow;
+	std::atomic<bool> overflowed;
+	std::atomic<uint32_t> overflow_count;
+
+	bool _try_push(const T &p_value) {
+		uint32_t pos = head.load(std::memory_order_relaxed);
+		while (true) {
+			Cell &cell = cells[pos & mask];
+			int32_t diff = (int32_t)(cell.seq.load(std::memory_order_acquire) - pos);
+			if (diff == 0) {
+				if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value = p_value;
+					cell.seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if (diff < 0) {
+				return false; // Full.
+			} else {
+				pos = head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+public:
+	// Safe to call from any thread.
+	void push(const T &p_value) {
+		if (!overflowed.load(std::memory_order_acquire) && _try_push(p_value)) {
+			return;
+		}
+		MutexLock lock(overflow_mutex);
+		overflow.push_back(p_value);
+		overflow_count.fetch_add(1, std::memory_order_relaxed);
+		overflowed.store(true, std::memory_order_release);
+	}
+
+	// Consumer thread only.
+	bool pop(T &r_value) {
+		Cell &cell = cells[tail & mask];
+		if (cell.seq.load(std::memory_order_acquire) == tail + 1) {
+			r_value = cell.value;
+			cell.value = T();
+			cell.seq.store(tail + mask + 1, std::memory_order_release);
+			tail++;
+			return true;
+		}
+		if (!overflowed.load(std::memory_order_acquire)) {
+			return false;
+		}
+		MutexLock lock(overflow_mutex);
+		if (overflow.empty()) {
+			overflowed.store(false, std::memory_order_release);
+			return false;
+		}
+		r_value = overflow.front()->get();
+		overflow.pop_front();
+		overflow_count.fetch_sub(1, std::memory_order_relaxed);
+		if (overflow.empty()) {
+			overflowed.store(false, std::memory_order_release);
+		}
+		return true;
+	}
+
+	// Consumer thread only.
+	bool is_empty() const {
+		return (cells[tail & mask].seq.load(std::memory_order_acquire) != tail + 1) && !overflowed.load(std::memory_order_acquire);
+	}
+
+	// Approximate, values may be pushed concurrently.
+	uint32_t size() const {
+		return (head.load(std::memory_order_relaxed) - tail) + overflow_count.load(std::memory_order_relaxed);
+	}
+
+	void clear() {
+		T value;
+		while (pop(value)) {
+		}
+	}
+
+	// Capacity of the ring is rounded up to a power of two.
+	explicit WebViewEventQueue(uint32_t p_capacity = 1024) {
+		uint32_t capacity = 2;
+		while (capacity < p_capacity) {
+			capacity <<= 1;
+		}
+		mask = capacity - 1;
+		cells = memnew_arr(Cell, capacity);
+		for (uint32_t i = 0; i < capacity; i++) {
+			cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+		head.store(0, std::memory_order_relaxed);
+		overflowed.store(false, std::memory_order_relaxed);
+		overflow_count.store(0, std::memory_order_relaxed);
+	}
+
+	~WebViewEventQueue() {
+		memdelete_arr(cells);
+	}
+};
+
+#endif // WEB_VIEW_EVENT_QUEUE_H
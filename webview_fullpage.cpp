@@ -0,0 +1,182 @@
+/*************************************************************************/
+/*  webview_fullpage.cpp                                                 */
+/*************************************************************************/
+
+#include "webview.h"
+#include "webview_backend.h"
+
+#include "core/math/math_funcs.h"
+#include "core/os/os.h"
+
+/*************************************************************************/
+
+Error WebViewOverlay::get_full_page_snapshot(int p_width, bool p_tiled) {
+	ERR_FAIL_COND_V(!is_ready(), ERR_UNCONFIGURED);
+	ERR_FAIL_COND_V_MSG(mock_backend, ERR_UNAVAILABLE, "Full-page snapshots require script evaluation, which is not supported by the mock backend.");
+	ERR_FAIL_COND_V_MSG(full_page.active, ERR_BUSY, "Full-page snapshot is already in progress.");
+	ERR_FAIL_COND_V(p_width <= 0, ERR_INVALID_PARAMETER);
+
+	full_page = FullPageCapture();
+	full_page.active = true;
+	full_page.tiled = p_tiled;
+	full_page.seq = next_snapshot_id++;
+	full_page.width = p_width;
+	full_page.deadline = OS::get_singleton()->get_ticks_msec() + FULL_PAGE_TIMEOUT_MSEC;
+
+	String metrics = "{type:\"page_metrics\",capture:" + String::num_uint64(full_page.seq) + ",scroll_y:Math.round(scrollY),viewport_width:innerWidth,viewport_height:innerHeight,page_height:Math.max(document.documentElement.scrollHeight,document.body?document.body.scrollHeight:0)}";
+	data->exec_script(_make_message_script(metrics));
+
+	set_process_internal(true);
+	return OK;
+}
+
+bool WebViewOverlay::is_full_page_snapshot_active() const {
+	return full_page.active;
+}
+
+void WebViewOverlay::_full_page_message(const Dictionary &p_message) {
+	if (!full_page.active || ((uint64_t)p_message.get("capture", 0) != full_page.seq)) {
+		return;
+	}
+	full_page.deadline = OS::get_singleton()->get_ticks_msec() + FULL_PAGE_TIMEOUT_MSEC;
+
+	String type = p_message["type"];
+	if (type == "page_metrics") {
+		full_page.scroll_y = p_message.get("scroll_y", 0);
+		full_page.viewport_width = p_message.get("viewport_width", 0);
+		full_page.viewport_height = p_message.get("viewport_height", 0);
+		full_page.page_height = p_message.get("page_height", 0);
+		if ((full_page.viewport_width <= 0) || (full_page.viewport_height <= 0) || (full_page.page_height <= 0)) {
+			ERR_PRINT("Invalid page metrics, full-page snapshot failed.");
+			_full_page_finish(false, false);
+			return;
+		}
+
+		// Page height is limited to a reasonable number of tiles, e.g. for infinite scrolling pages.
+		full_page.page_height = MIN(full_page.page_height, full_page.viewport_height * FULL_PAGE_MAX_TILES);
+		full_page.tile_count = (full_page.page_height + full_page.viewport_height - 1) / full_page.viewport_height;
+		full_page.offsets.resize(full_page.tile_count);
+		if (full_page.tiled) {
+			full_page.tiles.resize(full_page.tile_count);
+		}
+		_full_page_scroll(0);
+	} else if (type == "scrolled") {
+		int tile = p_message.get("tile", -1);
+		ERR_FAIL_INDEX(tile, full_page.tile_count);
+		full_page.offsets.write[tile] = p_message.get("y", 0);
+		_request_capture(full_page.width, false, -1, tile);
+	}
+}
+
+void WebViewOverlay::_full_page_scroll(int p_tile) {
+	// Tile is reported after two animation frames, when the scrolled content is painted.
+	String reply = _make_message_script("{type:\"scrolled\",capture:" + String::num_uint64(full_page.seq) + ",tile:" + itos(p_tile) + ",y:Math.round(scrollY)}");
+	String script = "scrollTo(0," + itos(p_tile * full_page.viewport_height) + ");requestAnimationFrame(function(){requestAnimationFrame(function(){" + reply + "});});";
+	data->exec_script(script);
+}
+
+void WebViewOverlay::_full_page_tile_captured(int p_tile) {
+	if (full_page.active && (p_tile + 1 < full_page.tile_count)) {
+		_full_page_scroll(p_tile + 1);
+	}
+}
+
+void WebViewOverlay::_full_page_tile_ready(int p_tile, const Ref<Image> &p_image) {
+	ERR_FAIL_COND(!full_page.active);
+	ERR_FAIL_INDEX(p_tile, full_page.tile_count);
+	full_page.deadline = OS::get_singleton()->get_ticks_msec() + FULL_PAGE_TIMEOUT_MSEC;
+
+	Ref<Image> tile = p_image;
+	bool pooled = true;
+	if ((tile->get_format() != Image::FORMAT_RGBA8) || tile->has_mipmaps()) {
+		tile = p_image->duplicate();
+		tile->clear_mipmaps();
+		tile->convert(Image::FORMAT_RGBA8);
+		pooled = false;
+	}
+
+	// Page rows of the tile, last tile is usually clamped by the browser and
+	// scrolled less than a full viewport, its top rows overlap the previous tile.
+	float scale = (float)tile->get_width() / full_page.viewport_width;
+	int top = p_tile * full_page.viewport_height;
+	int bottom = MIN(top + full_page.viewport_height, full_page.page_height);
+	int src_y = CLAMP((int)Math::round((top - full_page.offsets[p_tile]) * scale), 0, tile->get_height());
+	int dst_y = (int)Math::round(top * scale);
+	int height = MIN((int)Math::round(bottom * scale) - dst_y, tile->get_height() - src_y);
+	if (height <= 0) {
+		ERR_PRINT("Full-page snapshot tile is empty.");
+		_full_page_finish(false, true);
+		return;
+	}
+
+	if (full_page.tiled) {
+		if ((src_y == 0) && (height == tile->get_height())) {
+			full_page.tiles[p_tile] = tile;
+		} else {
+			full_page.tiles[p_tile] = tile->get_rect(Rect2(0, src_y, tile->get_width(), height));
+		}
+	} else {
+		if (full_page.image.is_null()) {
+			// Page too large for a single image is returned in tiles.
+			int page_height = (int)Math::round(full_page.page_height * scale);
+			if ((tile->get_width() > Image::MAX_WIDTH) || (page_height > Image::MAX_HEIGHT)) {
+				WARN_PRINT("Full-page snapshot exceeds the maximum image size, returning tiles.");
+				full_page.tiled = true;
+				full_page.tiles.resize(full_page.tile_count);
+				_full_page_tile_ready(p_tile, tile);
+				return;
+			}
+			full_page.image.instance();
+			full_page.image->create(tile->get_width(), page_height, false, Image::FORMAT_RGBA8);
+		}
+		if (tile->get_width() != full_page.image->get_width()) {
+			ERR_PRINT("Full-page snapshot tile width mismatch.");
+			_full_page_finish(false, true);
+			return;
+		}
+		height = MIN(height, full_page.image->get_height() - dst_y);
+		full_page.image->blit_rect(tile, Rect2(0, src_y, tile->get_width(), height), Point2(0, dst_y));
+		if (pooled) {
+			snapshot_pool->recycle(tile);
+		}
+	}
+
+	full_page.tiles_done++;
+	if (full_page.tiles_done == full_page.tile_count) {
+		_full_page_finish(true, true);
+	}
+}
+
+void WebViewOverlay::_full_page_finish(bool p_success, bool p_restore) {
+	// Late results of the pending tiles are ignored.
+	Map<uint64_t, SnapshotRequest>::Element *E = snapshot_requests.front();
+	while (E) {
+		Map<uint64_t, SnapshotRequest>::Element *N = E->next();
+		if (E->get().tile >= 0) {
+			snapshot_requests.erase(E);
+		}
+		E = N;
+	}
+
+	if (p_restore && is_ready()) {
+		data->exec_script("scrollTo(0," + itos(full_page.scroll_y) + ");");
+	}
+
+	Array images;
+	if (p_success) {
+		if (full_page.tiled) {
+			images = full_page.tiles;
+		} else {
+			images.push_back(full_page.image);
+		}
+	}
+	full_page = FullPageCapture();
+	emit_signal("full_page_snapshot_ready", images);
+}
+
+void WebViewOverlay::_process_full_page() {
+	if (OS::get_singleton()->get_ticks_msec() > full_page.deadline) {
+		ERR_PRINT("Full-page snapshot timed out.");
+		_full_page_finish(false, true);
+	}
+}
@@ -0,0 +1,760 @@
+/*************************************************************************/
+/*  webview_gtk.cpp                                                      */
+/*************************************************************************/
+
+#include "webview_backend.h"
+#include "webview_resource.h"
+#include "core/os/os.h"
+
+#include <gio/gunixinputstream.h>
+#include <gtk/gtk.h>
+#include <webkit2/webkit2.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Binary endpoint needs the request body and response headers of the scheme requests.
+#if WEBKIT_CHECK_VERSION(2, 40, 0)
+#define WEBVIEW_GTK_BINARY_ENDPOINT
+#endif
+
+/*************************************************************************/
+
+class WebViewOverlayGTK : public WebViewOverlayImplementation {
+public:
+	GtkWidget *window = nullptr;
+	WebKitWebView *view = nullptr;
+	WebKitSettings *settings = nullptr;
+	WebKitUserScript *bridge_script = nullptr;
+
+	cairo_surface_t *frame_surface = nullptr;
+	PoolVector<uint8_t> frame_data;
+	Ref<ImageTexture> texture;
+	bool dirty = false;
+
+	GCancellable *cancellable = nullptr;
+	bool no_background = false;
+
+	// Streamed document is written to a socket, WebKit reads the peer end when it
+	// requests the stream URL. Writes are non-blocking, the rest of a chunk is kept
+	// until the reader catches up.
+	String stream_url;
+	int stream_fd = -1;
+	int stream_peer_fd = -1; // Owned by the input stream once the request arrives.
+	CharString stream_pending;
+	int stream_pending_pos = 0;
+	bool stream_ending = false;
+
+	bool _flush_document_stream();
+	void _close_document_stream();
+
+	virtual Error create();
+	virtual void destroy();
+	virtual bool is_created() const;
+	virtual bool is_ready() const;
+
+	virtual void process();
+	virtual bool needs_process() const;
+
+	virtual bool is_offscreen() const;
+	virtual void set_bounds(const Rect2 &p_rect);
+	virtual void set_visible(bool p_visible);
+
+	virtual void set_no_background(bool p_bg);
+	virtual void set_user_agent(const String &p_user_agent);
+	virtual String get_user_agent() const;
+	virtual void set_zoom_level(double p_zoom);
+	virtual double get_zoom_level() const;
+
+	virtual void navigate(const String &p_url);
+	virtual String get_url() const;
+	virtual String get_title() const;
+	virtual void load_string(const String &p_source);
+	virtual void exec_script(const String &p_script);
+	virtual void evaluate_script(const String &p_script, uint64_t p_id);
+	virtual String get_binary_endpoint() const;
+	virtual void set_document_start_script(const String &p_source);
+	virtual void document_stream_begin(const String &p_url);
+	virtual bool document_stream_can_write();
+	virtual void document_stream_write(const CharString &p_chunk);
+	virtual void document_stream_end();
+	virtual void document_stream_abort();
+	virtual void capture(int p_width, uint64_t p_id);
+	virtual Ref<Texture> get_texture() const;
+
+	virtual bool can_go_back() const;
+	virtual bool can_go_forward() const;
+	virtual bool is_loading() const;
+	virtual bool is_secure_content() const;
+	virtual void go_back();
+	virtual void go_forward();
+	virtual void reload();
+	virtual void stop();
+};
+
+/*************************************************************************/
+
+static Map<String, WebViewOverlayGTK *> _webview_streams;
+
+// Input stream of a local resource, WebKit reads it asynchronously (read_fn runs
+// on a GIO worker thread), chunks are read directly to the WebKit buffer.
+typedef struct {
+	GInputStream parent_instance;
+	WebViewResourceReader *reader;
+} WebViewResourceStream;
+
+typedef struct {
+	GInputStreamClass parent_class;
+} WebViewResourceStreamClass;
+
+G_DEFINE_TYPE(WebViewResourceStream, webview_resource_stream, G_TYPE_INPUT_STREAM)
+
+static gssize _webview_resource_stream_read(GInputStream *p_stream, void *p_buffer, gsize p_count, GCancellable *p_cancellable, GError **r_error) {
+	WebViewResourceStream *self = (WebViewResourceStream *)p_stream;
+	return (gssize)self->reader->read((uint8_t *)p_buffer, p_count);
+}
+
+static gboolean _webview_resource_stream_close(GInputStream *p_stream, GCancellable *p_cancellable, GError **r_error) {
+	WebViewResourceStream *self = (WebViewResourceStream *)p_stream;
+	self->reader->close();
+	return TRUE;
+}
+
+static void _webview_resource_stream_finalize(GObject *p_object) {
+	WebViewResourceStream *self = (WebViewResourceStream *)p_object;
+	memdelete(self->reader);
+	G_OBJECT_CLASS(webview_resource_stream_parent_class)->finalize(p_object);
+}
+
+static void webview_resource_stream_class_init(WebViewResourceStreamClass *p_class) {
+	G_OBJECT_CLASS(p_class)->finalize = _webview_resource_stream_finalize;
+	G_INPUT_STREAM_CLASS(p_class)->read_fn = _webview_resource_stream_read;
+	G_INPUT_STREAM_CLASS(p_class)->close_fn = _webview_resource_stream_close;
+}
+
+static void webview_resource_stream_init(WebViewResourceStream *p_stream) {
+	p_stream->reader = nullptr;
+}
+
+static GInputStream *_webview_resource_stream_new(WebViewResourceReader *p_reader) {
+	WebViewResourceStream *stream = (WebViewResourceStream *)g_object_new(webview_resource_stream_get_type(), nullptr);
+	stream->reader = p_reader;
+	return G_INPUT_STREAM(stream);
+}
+
+static void _webview_load_changed(WebKitWebView *p_view, WebKitLoadEvent p_event, gpointer p_user_data) {
+	WebViewOverlayGTK *data = (WebViewOverlayGTK *)p_user_data;
+	if (p_event == WEBKIT_LOAD_STARTED) {
+		data->control->_post_event(WebViewOverlay::INBOUND_START_NAVIGATION);
+	} else if (p_event == WEBKIT_LOAD_FINISHED) {
+		data->control->_post_event(WebViewOverlay::INBOUND_FINISH_NAVIGATION);
+	}
+}
+
+static GtkWidget *_webview_create(WebKitWebView *p_view, WebKitNavigationAction *p_action, gpointer p_user_data) {
+	WebViewOverlayGTK *data = (WebViewOverlayGTK *)p_user_data;
+	WebKitURIRequest *request = webkit_navigation_action_get_request(p_action);
+	data->control->_post_event(WebViewOverlay::INBOUND_NEW_WINDOW, String::utf8(webkit_uri_request_get_uri(request)));
+	return nullptr;
+}
+
+static void _webview_message_received(WebKitUserContentManager *p_manager, WebKitJavascriptResult *p_result, gpointer p_user_data) {
+	WebViewOverlayGTK *data = (WebViewOverlayGTK *)p_user_data;
+	char *str = jsc_value_to_string(webkit_javascript_result_get_js_value(p_result));
+	data->control->_post_event(WebViewOverlay::INBOUND_MESSAGE, String::utf8(str));
+	g_free(str);
+}
+
+static gboolean _webview_damage(GtkWidget *p_widget, GdkEvent *p_event, gpointer p_user_data) {
+	WebViewOverlayGTK *data = (WebViewOverlayGTK *)p_user_data;
+	data->dirty = true;
+	return FALSE;
+}
+
+static void _webview_scheme_request(WebKitURISchemeRequest *p_request, gpointer p_user_data) {
+	String url = String::utf8(webkit_uri_scheme_request_get_uri(p_request));
+
+	Map<String, WebViewOverlayGTK *>::Element *S = _webview_streams.find(url);
+	if (S && (S->get()->stream_peer_fd != -1)) {
+		GInputStream *stream = g_unix_input_stream_new(S->get()->stream_peer_fd, TRUE);
+		S->get()->stream_peer_fd = -1;
+		webkit_uri_scheme_request_finish(p_request, stream, -1, "text/html");
+		g_object_unref(stream);
+		return;
+	}
+
+	WebViewResourceReader *reader = memnew(WebViewResourceReader);
+	if (reader->open(url) != OK) {
+		memdelete(reader);
+		GError *error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "File not found.");
+		webkit_uri_scheme_request_finish_error(p_request, error);
+		g_error_free(error);
+		return;
+	}
+
+	GInputStream *stream = _webview_resource_stream_new(reader);
+	webkit_uri_scheme_request_finish(p_request, stream, reader->get_size(), reader->get_mime_type().utf8().get_data());
+	g_object_unref(stream);
+}
+
+#ifdef WEBVIEW_GTK_BINARY_ENDPOINT
+
+// Response payload is referenced (and its buffer locked) until WebKit has read it.
+struct WebViewBinaryResponse {
+	PoolByteArray data;
+	PoolByteArray::Read read;
+};
+
+static void _webview_binary_response_free(gpointer p_data) {
+	memdelete((WebViewBinaryResponse *)p_data);
+}
+
+static void _webview_binary_request(WebKitURISchemeRequest *p_request, gpointer p_user_data) {
+	// Body is read once, directly to the payload passed to the signal.
+	PoolByteArray body;
+	GInputStream *body_stream = webkit_uri_scheme_request_get_http_body(p_request);
+	if (body_stream != nullptr) {
+		int size = 0;
+		while (size <= WebViewOverlay::MAX_BINARY_TRANSFER_SIZE) { // Larger body is refused.
+			body.resize(size + WebViewResourceReader::CHUNK_SIZE);
+			gssize len;
+			{
+				PoolByteArray::Write w = body.write();
+				len = g_input_stream_read(body_stream, w.ptr() + size, WebViewResourceReader::CHUNK_SIZE, nullptr, nullptr);
+			}
+			if (len <= 0) {
+				break;
+			}
+			size += len;
+		}
+		body.resize(size);
+		g_object_unref(body_stream);
+	}
+
+	WebViewBinaryResponse *response = memnew(WebViewBinaryResponse);
+	int status = WebViewOverlay::_binary_request(String::utf8(webkit_uri_scheme_request_get_path(p_request)).trim_prefix("/"), body, response->data);
+	response->read = response->data.read();
+	int size = response->data.size();
+	GBytes *bytes = g_bytes_new_with_free_func(response->read.ptr(), size, _webview_binary_response_free, response);
+	GInputStream *stream = g_memory_input_stream_new_from_bytes(bytes);
+	g_bytes_unref(bytes);
+
+	WebKitURISchemeResponse *scheme_response = webkit_uri_scheme_response_new(stream, size);
+	webkit_uri_scheme_response_set_status(scheme_response, status, nullptr);
+	webkit_uri_scheme_response_set_content_type(scheme_response, "application/octet-stream");
+	SoupMessageHeaders *headers = soup_message_headers_new(SOUP_MESSAGE_HEADERS_RESPONSE);
+	soup_message_headers_append(headers, "Access-Control-Allow-Origin", "*");
+	webkit_uri_scheme_response_set_http_headers(scheme_response, headers);
+	webkit_uri_scheme_request_finish_with_response(p_request, scheme_response);
+	g_object_unref(scheme_response);
+	g_object_unref(stream);
+}
+
+#endif
+
+// Cairo ARGB32 is premultiplied and native endian, i.e. BGRA byte order on little endian hosts.
+static const WebViewPixels::Format _webview_cairo_format = WebViewPixels::FORMAT_BGRA8_PREMULTIPLIED;
+
+static Ref<Image> _webview_image_from_surface(cairo_surface_t *p_surface, PoolVector<uint8_t> &r_data) {
+	cairo_surface_flush(p_surface);
+
+	int width = cairo_image_surface_get_width(p_surface);
+	int height = cairo_image_surface_get_height(p_surface);
+	ERR_FAIL_COND_V(width <= 0 || height <= 0, Ref<Image>());
+
+	r_data.resize(width * height * 4);
+	{
+		PoolVector<uint8_t>::Write wr = r_data.write();
+		WebViewPixels::convert_to_rgba8(cairo_image_surface_get_data(p_surface), cairo_image_surface_get_stride(p_surface), _webview_cairo_format, wr.ptr(), width, height);
+	}
+
+	Ref<Image> image;
+	image.instance();
+	image->create(width, height, false, Image::FORMAT_RGBA8, r_data);
+	return image;
+}
+
+// Snapshot surface is scaled and converted on the snapshot worker thread.
+class WebViewCairoSnapshotSource : public WebViewSnapshotSource {
+public:
+	cairo_surface_t *surface = nullptr;
+	int snapshot_width = 0;
+
+	virtual const uint8_t *lock() {
+		int surface_width = cairo_image_surface_get_width(surface);
+		int surface_height = cairo_image_surface_get_height(surface);
+		if ((snapshot_width > 0) && (surface_width > 0) && (snapshot_width != surface_width)) {
+			// Scale with Cairo, before conversion, instead of resizing converted image.
+			int scaled_height = MAX(surface_height * snapshot_width / surface_width, 1);
+			cairo_surface_t *scaled = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, snapshot_width, scaled_height);
+			cairo_t *cr = cairo_create(scaled);
+			cairo_scale(cr, (double)snapshot_width / surface_width, (double)scaled_height / surface_height);
+			cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+			cairo_set_source_surface(cr, surface, 0, 0);
+			cairo_paint(cr);
+			cairo_destroy(cr);
+
+			cairo_surface_destroy(surface);
+			surface = scaled;
+		}
+
+		cairo_surface_flush(surface);
+		width = cairo_image_surface_get_width(surface);
+		height = cairo_image_surface_get_height(surface);
+		stride = cairo_image_surface_get_stride(surface);
+		return cairo_image_surface_get_data(surface);
+	}
+
+	virtual ~WebViewCairoSnapshotSource() {
+		cairo_surface_destroy(surface);
+	}
+};
+
+struct WebViewSnapshotRequest {
+	WebViewOverlayGTK *data = nullptr;
+	uint64_t id = 0;
+	int width = 0;
+};
+
+static void _webview_snapshot_ready(GObject *p_object, GAsyncResult *p_result, gpointer p_user_data) {
+	WebViewSnapshotRequest *request = (WebViewSnapshotRequest *)p_user_data;
+	WebViewOverlayGTK *data = request->data;
+	uint64_t id = request->id;
+	int snapshot_width = request->width;
+	memdelete(request);
+
+	GError *error = nullptr;
+	cairo_surface_t *surface = webkit_web_view_get_snapshot_finish(WEBKIT_WEB_VIEW(p_object), p_result, &error);
+	if (surface == nullptr) {
+		// View is already destroyed if request is cancelled.
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			ERR_PRINT("WebKitGTK snapshot failed: " + String::utf8(error->message));
+			data->control->_snapshot_failed(id);
+		}
+		g_error_free(error);
+		return;
+	}
+
+	WebViewCairoSnapshotSource *source = memnew(WebViewCairoSnapshotSource);
+	source->format = _webview_cairo_format;
+	source->surface = surface;
+	source->snapshot_width = snapshot_width;
+	data->control->_snapshot_ready_source(id, source);
+}
+
+struct WebViewScriptRequest {
+	WebViewOverlayGTK *data = nullptr;
+	uint64_t id = 0;
+};
+
+static void _webview_script_ready(GObject *p_object, GAsyncResult *p_result, gpointer p_user_data) {
+	WebViewScriptRequest *request = (WebViewScriptRequest *)p_user_data;
+	WebViewOverlayGTK *data = request->data;
+	uint64_t id = request->id;
+	memdelete(request);
+
+	GError *error = nullptr;
+	WebKitJavascriptResult *result = webkit_web_view_run_javascript_finish(WEBKIT_WEB_VIEW(p_object), p_result, &error);
+	if (result == nullptr) {
+		// View is already destroyed if request is cancelled.
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			data->control->_script_failed(id, String::utf8(error->message));
+		}
+		g_error_free(error);
+		return;
+	}
+
+	// Undefined and functions have no JSON representation.
+	char *json = jsc_value_to_json(webkit_javascript_result_get_js_value(result), 0);
+	if (json != nullptr) {
+		data->control->_script_evaluated_json(id, String::utf8(json));
+		g_free(json);
+	} else {
+		data->control->_script_evaluated(id, Variant());
+	}
+	webkit_javascript_result_unref(result);
+}
+
+/*************************************************************************/
+
+Error WebViewOverlayGTK::create() {
+	// Offscreen window still needs a display connection, also in server builds.
+	ERR_FAIL_COND_V_MSG(gdk_display_get_default() == nullptr, ERR_CANT_CREATE, "WebKitGTK needs a display, headless servers must run a virtual X server (e.g. Xvfb) and set DISPLAY.");
+
+	Size2i size = control->get_size();
+
+	WebKitUserContentManager *ucm = webkit_user_content_manager_new();
+	webkit_user_content_manager_register_script_message_handler(ucm, "callback");
+	g_signal_connect(ucm, "script-message-received::callback", G_CALLBACK(_webview_message_received), this);
+
+	String bridge = "function webviewMessage(s){window.webkit.messageHandlers.callback.postMessage(s);}" + control->_get_binary_endpoint_script() + WebViewOverlay::get_bridge_script();
+	bridge_script = webkit_user_script_new(bridge.utf8().get_data(), WEBKIT_USER_CONTENT_INJECT_TOP_FRAME, WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_START, nullptr, nullptr);
+	webkit_user_content_manager_add_script(ucm, bridge_script);
+
+	settings = webkit_settings_new();
+	webkit_settings_set_hardware_acceleration_policy(settings, WEBKIT_HARDWARE_ACCELERATION_POLICY_NEVER);
+
+	view = WEBKIT_WEB_VIEW(webkit_web_view_new_with_user_content_manager(ucm));
+	g_object_unref(ucm);
+	webkit_web_view_set_settings(view, settings);
+	g_signal_connect(view, "load-changed", G_CALLBACK(_webview_load_changed), this);
+	g_signal_connect(view, "create", G_CALLBACK(_webview_create), this);
+
+	cancellable = g_cancellable_new();
+
+	window = gtk_offscreen_window_new();
+	gtk_window_set_default_size(GTK_WINDOW(window), MAX(size.width, 1), MAX(size.height, 1));
+	gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(view));
+	g_signal_connect(window, "damage-event", G_CALLBACK(_webview_damage), this);
+	gtk_widget_show_all(window);
+
+	return OK;
+}
+
+void WebViewOverlayGTK::destroy() {
+	_close_document_stream();
+	if (cancellable != nullptr) {
+		g_cancellable_cancel(cancellable);
+		g_object_unref(cancellable);
+		cancellable = nullptr;
+	}
+	if (view != nullptr) {
+		gtk_widget_destroy(window);
+		g_object_unref(settings);
+		webkit_user_script_unref(bridge_script);
+		window = nullptr;
+		view = nullptr;
+		settings = nullptr;
+		bridge_script = nullptr;
+	}
+	if (frame_surface != nullptr) {
+		cairo_surface_destroy(frame_surface);
+		frame_surface = nullptr;
+	}
+	texture.unref();
+}
+
+bool WebViewOverlayGTK::is_created() const {
+	return (view != nullptr);
+}
+
+bool WebViewOverlayGTK::is_ready() const {
+	return (view != nullptr);
+}
+
+bool WebViewOverlayGTK::needs_process() const {
+	return (view != nullptr); // Offscreen view is updated every frame.
+}
+
+void WebViewOverlayGTK::process() {
+	while (g_main_context_iteration(nullptr, FALSE)) {
+		// Pump WebKit events.
+	}
+
+	// Rest of the document is written as the reader drains the socket.
+	if ((stream_fd != -1) && (stream_peer_fd == -1) && stream_ending && _flush_document_stream()) {
+		_close_document_stream();
+		control->_document_stream_done();
+	}
+
+	if ((view == nullptr) || !dirty || !control->is_visible_in_tree()) {
+		return;
+	}
+	dirty = false;
+
+	cairo_surface_t *surface = gtk_offscreen_window_get_surface(GTK_OFFSCREEN_WINDOW(window));
+	if (surface == nullptr) {
+		return;
+	}
+
+	int width = gtk_widget_get_allocated_width(window);
+	int height = gtk_widget_get_allocated_height(window);
+	if ((frame_surface == nullptr) || (cairo_image_surface_get_width(frame_surface) != width) || (cairo_image_surface_get_height(frame_surface) != height)) {
+		if (frame_surface != nullptr) {
+			cairo_surface_destroy(frame_surface);
+		}
+		frame_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	}
+
+	// Offscreen window surface is not necessarily an image surface, copy it to the shared frame buffer.
+	cairo_t *cr = cairo_create(frame_surface);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface(cr, surface, 0, 0);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+
+	Ref<Image> image = _webview_image_from_surface(frame_surface, frame_data);
+	if (image.is_valid()) {
+		if (texture.is_null()) {
+			texture.instance();
+		}
+		if ((texture->get_width() == width) && (texture->get_height() == height)) {
+			texture->set_data(image);
+		} else {
+			texture->create_from_image(image, Texture::FLAG_FILTER);
+		}
+		control->update();
+	}
+}
+
+bool WebViewOverlayGTK::is_offscreen() const {
+	return true;
+}
+
+void WebViewOverlayGTK::set_bounds(const Rect2 &p_rect) {
+	gtk_window_resize(GTK_WINDOW(window), MAX((int)p_rect.size.width, 1), MAX((int)p_rect.size.height, 1));
+}
+
+void WebViewOverlayGTK::set_visible(bool p_visible) {
+	dirty = true;
+}
+
+void WebViewOverlayGTK::capture(int p_width, uint64_t p_id) {
+	WebViewSnapshotRequest *request = memnew(WebViewSnapshotRequest);
+	request->data = this;
+	request->id = p_id;
+	request->width = p_width;
+	webkit_web_view_get_snapshot(view, WEBKIT_SNAPSHOT_REGION_VISIBLE, (no_background) ? WEBKIT_SNAPSHOT_OPTIONS_TRANSPARENT_BACKGROUND : WEBKIT_SNAPSHOT_OPTIONS_NONE, cancellable, _webview_snapshot_ready, request);
+}
+
+Ref<Texture> WebViewOverlayGTK::get_texture() const {
+	return texture;
+}
+
+void WebViewOverlayGTK::set_no_background(bool p_bg) {
+	no_background = p_bg;
+
+	GdkRGBA color = { 1.0, 1.0, 1.0, (no_background) ? 0.0 : 1.0 };
+	webkit_web_view_set_background_color(view, &color);
+}
+
+void WebViewOverlayGTK::navigate(const String &p_url) {
+	webkit_web_view_load_uri(view, p_url.utf8().get_data());
+}
+
+String WebViewOverlayGTK::get_url() const {
+	const gchar *uri = webkit_web_view_get_uri(view);
+	return (uri != nullptr) ? String::utf8(uri) : String();
+}
+
+void WebViewOverlayGTK::set_user_agent(const String &p_user_agent) {
+	webkit_settings_set_user_agent(settings, (p_user_agent.length() > 0) ? p_user_agent.utf8().get_data() : nullptr);
+}
+
+String WebViewOverlayGTK::get_user_agent() const {
+	return String::utf8(webkit_settings_get_user_agent(settings));
+}
+
+double WebViewOverlayGTK::get_zoom_level() const {
+	return webkit_web_view_get_zoom_level(view);
+}
+
+void WebViewOverlayGTK::set_zoom_level(double p_zoom) {
+	webkit_web_view_set_zoom_level(view, p_zoom);
+}
+
+String WebViewOverlayGTK::get_title() const {
+	const gchar *title = webkit_web_view_get_title(view);
+	return (title != nullptr) ? String::utf8(title) : String();
+}
+
+void WebViewOverlayGTK::exec_script(const String &p_script) {
+	webkit_web_view_run_javascript(view, p_script.utf8().get_data(), nullptr, nullptr, nullptr);
+}
+
+void WebViewOverlayGTK::set_document_start_script(const String &p_source) {
+	// Scripts can't be removed individually (before WebKitGTK 2.32), bridge is added again.
+	WebKitUserContentManager *ucm = webkit_web_view_get_user_content_manager(view);
+	webkit_user_content_manager_remove_all_scripts(ucm);
+	webkit_user_content_manager_add_script(ucm, bridge_script);
+	if (!p_source.empty()) {
+		WebKitUserScript *scr = webkit_user_script_new(p_source.utf8().get_data(), WEBKIT_USER_CONTENT_INJECT_TOP_FRAME, WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_START, nullptr, nullptr);
+		webkit_user_content_manager_add_script(ucm, scr);
+		webkit_user_script_unref(scr);
+	}
+}
+
+void WebViewOverlayGTK::evaluate_script(const String &p_script, uint64_t p_id) {
+	WebViewScriptRequest *request = memnew(WebViewScriptRequest);
+	request->data = this;
+	request->id = p_id;
+	webkit_web_view_run_javascript(view, p_script.utf8().get_data(), cancellable, _webview_script_ready, request);
+}
+
+String WebViewOverlayGTK::get_binary_endpoint() const {
+#ifdef WEBVIEW_GTK_BINARY_ENDPOINT
+	return "webview-bin://binary/";
+#else
+	return String();
+#endif
+}
+
+void WebViewOverlayGTK::load_string(const String &p_source) {
+	webkit_web_view_load_html(view, p_source.utf8().get_data(), nullptr);
+}
+
+void WebViewOverlayGTK::document_stream_begin(const String &p_url) {
+	_close_document_stream();
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+		ERR_PRINT("Failed to create document stream socket.");
+		control->_document_stream_closed();
+		return;
+	}
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	stream_fd = fds[0];
+	stream_peer_fd = fds[1];
+	stream_url = p_url;
+	_webview_streams[stream_url] = this;
+
+	// Byte order mark, the response has no charset.
+	stream_pending = CharString("\xEF\xBB\xBF");
+	stream_pending_pos = 0;
+
+	webkit_web_view_load_uri(view, p_url.utf8().get_data());
+}
+
+bool WebViewOverlayGTK::document_stream_can_write() {
+	if ((stream_fd == -1) || (stream_peer_fd != -1) || stream_ending) {
+		return false; // Not requested by WebKit yet.
+	}
+	return _flush_document_stream();
+}
+
+void WebViewOverlayGTK::document_stream_write(const CharString &p_chunk) {
+	ERR_FAIL_COND(stream_fd == -1);
+	ERR_FAIL_COND(stream_pending_pos < stream_pending.length()); // Written only when can_write returns true.
+	stream_pending = p_chunk;
+	stream_pending_pos = 0;
+	_flush_document_stream();
+}
+
+void WebViewOverlayGTK::document_stream_end() {
+	stream_ending = true;
+	if ((stream_fd != -1) && _flush_document_stream()) {
+		_close_document_stream();
+		control->_document_stream_done();
+	}
+}
+
+void WebViewOverlayGTK::document_stream_abort() {
+	_close_document_stream();
+}
+
+bool WebViewOverlayGTK::_flush_document_stream() {
+	while (stream_pending_pos < stream_pending.length()) {
+		ssize_t sent = send(stream_fd, stream_pending.get_data() + stream_pending_pos, stream_pending.length() - stream_pending_pos, MSG_NOSIGNAL);
+		if (sent > 0) {
+			stream_pending_pos += sent;
+		} else if ((sent < 0) && (errno == EINTR)) {
+			continue;
+		} else if ((sent < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+			return false;
+		} else {
+			// Reader was closed, the view navigated away or stopped loading.
+			_close_document_stream();
+			control->_document_stream_closed();
+			return false;
+		}
+	}
+	stream_pending = CharString();
+	stream_pending_pos = 0;
+	return true;
+}
+
+void WebViewOverlayGTK::_close_document_stream() {
+	if (stream_fd != -1) {
+		close(stream_fd);
+		stream_fd = -1;
+	}
+	if (stream_peer_fd != -1) {
+		close(stream_peer_fd);
+		stream_peer_fd = -1;
+	}
+	if (!stream_url.empty()) {
+		_webview_streams.erase(stream_url);
+		stream_url = String();
+	}
+	stream_pending = CharString();
+	stream_pending_pos = 0;
+	stream_ending = false;
+}
+
+bool WebViewOverlayGTK::can_go_back() const {
+	return webkit_web_view_can_go_back(view);
+}
+
+bool WebViewOverlayGTK::can_go_forward() const {
+	return webkit_web_view_can_go_forward(view);
+}
+
+bool WebViewOverlayGTK::is_loading() const {
+	return webkit_web_view_is_loading(view);
+}
+
+bool WebViewOverlayGTK::is_secure_content() const {
+	GTlsCertificate *certificate = nullptr;
+	GTlsCertificateFlags errors;
+	return webkit_web_view_get_tls_info(view, &certificate, &errors) && (errors == 0);
+}
+
+void WebViewOverlayGTK::go_back() {
+	webkit_web_view_go_back(view);
+}
+
+void WebViewOverlayGTK::go_forward() {
+	webkit_web_view_go_forward(view);
+}
+
+void WebViewOverlayGTK::reload() {
+	webkit_web_view_reload(view);
+}
+
+void WebViewOverlayGTK::stop() {
+	webkit_web_view_stop_loading(view);
+}
+
+/*************************************************************************/
+
+int WebViewOverlayImplementation::init_native() {
+	// GTK would set the process locale, which breaks float parsing in the engine (comma decimal separator).
+	gtk_disable_setlocale();
+	if (!gtk_init_check(nullptr, nullptr)) {
+		return 1;
+	}
+
+	WebKitWebContext *context = webkit_web_context_get_default();
+	webkit_web_context_register_uri_scheme(context, "res", _webview_scheme_request, nullptr, nullptr);
+	webkit_web_context_register_uri_scheme(context, "user", _webview_scheme_request, nullptr, nullptr);
+#ifdef WEBVIEW_GTK_BINARY_ENDPOINT
+	// Binary endpoint is fetched by pages of any origin, also secure ones.
+	webkit_web_context_register_uri_scheme(context, "webview-bin", _webview_binary_request, nullptr, nullptr);
+	WebKitSecurityManager *security = webkit_web_context_get_security_manager(context);
+	webkit_security_manager_register_uri_scheme_as_cors_enabled(security, "webview-bin");
+	webkit_security_manager_register_uri_scheme_as_secure(security, "webview-bin");
+#endif
+
+	return 0;
+}
+
+void WebViewOverlayImplementation::finish_native() {
+	//NOP
+}
+
+String WebViewOverlayImplementation::get_native_error(int p_status) {
+	switch (p_status) {
+		case 1: {
+			return "Failed to initialize GTK, no display is available.";
+		} break;
+		default: {
+			return "Unknown error.";
+		} break;
+	};
+}
+
+WebViewOverlayImplementation *WebViewOverlayImplementation::create_native() {
+	return memnew(WebViewOverlayGTK());
+}
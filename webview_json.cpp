@@ -0,0 +1,342 @@
+/*************************************************************************/
+/*  webview_json.cpp                                                     */
+/*************************************************************************/
+
+#include "webview_json.h"
+
+#include "core/array.h"
+#include "core/dictionary.h"
+
+/*************************************************************************/
+
+class WebViewJSONDecoder {
+	enum {
+		MAX_DEPTH = 512,
+	};
+
+	const CharType *ptr = nullptr;
+	const CharType *end = nullptr;
+	int depth = 0;
+
+public:
+	String error;
+
+	WebViewJSONDecoder(const CharType *p_str, int p_length) {
+		ptr = p_str;
+		end = p_str + p_length;
+	}
+
+	_FORCE_INLINE_ void skip_space() {
+		while ((ptr < end) && ((*ptr == ' ') || (*ptr == '\n') || (*ptr == '\r') || (*ptr == '\t'))) {
+			ptr++;
+		}
+	}
+
+	_FORCE_INLINE_ bool at_end() const {
+		return ptr == end;
+	}
+
+	bool fail(const String &p_error) {
+		if (error.empty()) {
+			error = p_error;
+		}
+		return false;
+	}
+
+	bool parse_literal(const char *p_literal, const Variant &p_value, Variant &r_value) {
+		const CharType *p = ptr;
+		while (*p_literal) {
+			if ((p == end) || (*p != *p_literal)) {
+				return fail("Invalid literal.");
+			}
+			p++;
+			p_literal++;
+		}
+		ptr = p;
+		r_value = p_value;
+		return true;
+	}
+
+	static bool parse_hex4(const CharType *p_str, uint32_t &r_code) {
+		r_code = 0;
+		for (int i = 0; i < 4; i++) {
+			CharType c = p_str[i];
+			uint32_t v;
+			if ((c >= '0') && (c <= '9')) {
+				v = c - '0';
+			} else if ((c >= 'a') && (c <= 'f')) {
+				v = c - 'a' + 10;
+			} else if ((c >= 'A') && (c <= 'F')) {
+				v = c - 'A' + 10;
+			} else {
+				return false;
+			}
+			r_code = (r_code << 4) | v;
+		}
+		return true;
+	}
+
+	bool parse_string(String &r_string) {
+		ptr++; // Opening quote.
+
+		// Common case, no escapes.
+		const CharType *from = ptr;
+		while ((ptr < end) && (*ptr != '"') && (*ptr != '\\')) {
+			ptr++;
+		}
+		if (ptr == end) {
+			return fail("Unterminated string.");
+		}
+		if (*ptr == '"') {
+			r_string = String(from, ptr - from);
+			ptr++;
+			return true;
+		}
+
+		Vector<CharType> buffer;
+		buffer.resize(ptr - from);
+		memcpy(buffer.ptrw(), from, (ptr - from) * sizeof(CharType));
+
+		while (true) {
+			if (ptr == end) {
+				return fail("Unterminated string.");
+			}
+			CharType c = *ptr++;
+			if (c == '"') {
+				break;
+			}
+			if (c != '\\') {
+				buffer.push_back(c);
+				continue;
+			}
+			if (ptr == end) {
+				return fail("Unterminated string.");
+			}
+			c = *ptr++;
+			switch (c) {
+				case '"':
+				case '\\':
+				case '/': {
+					buffer.push_back(c);
+				} break;
+				case 'b': {
+					buffer.push_back('\b');
+				} break;
+				case 'f': {
+					buffer.push_back('\f');
+				} break;
+				case 'n': {
+					buffer.push_back('\n');
+				} break;
+				case 'r': {
+					buffer.push_back('\r');
+				} break;
+				case 't': {
+					buffer.push_back('\t');
+				} break;
+				case 'u': {
+					uint32_t code;
+					if ((end - ptr < 4) || !parse_hex4(ptr, code)) {
+						return fail("Invalid unicode escape.");
+					}
+					ptr += 4;
+					// Surrogate pairs are combined where CharType is 32-bit.
+					uint32_t low;
+					if ((sizeof(CharType) == 4) && (code >= 0xD800) && (code <= 0xDBFF) && (end - ptr >= 6) && (ptr[0] == '\\') && (ptr[1] == 'u') && parse_hex4(ptr + 2, low) && (low >= 0xDC00) && (low <= 0xDFFF)) {
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						ptr += 6;
+					}
+					buffer.push_back((CharType)code);
+				} break;
+				default: {
+					return fail("Invalid escape sequence.");
+				}
+			}
+		}
+		r_string = String(buffer.ptr(), buffer.size());
+		return true;
+	}
+
+	bool parse_number(Variant &r_value) {
+		const CharType *from = ptr;
+		bool negative = false;
+		if (*ptr == '-') {
+			negative = true;
+			ptr++;
+		}
+		if ((ptr == end) || (*ptr < '0') || (*ptr > '9')) {
+			return fail("Invalid number.");
+		}
+
+		// Integers are accumulated directly, those which don't fit in int64 are
+		// decoded as float.
+		const uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+		uint64_t value = 0;
+		bool is_real = false;
+		while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+			uint64_t digit = *ptr - '0';
+			if (value > (limit - digit) / 10) {
+				is_real = true;
+			} else if (!is_real) {
+				value = value * 10 + digit;
+			}
+			ptr++;
+		}
+		if ((ptr < end) && (*ptr == '.')) {
+			is_real = true;
+			ptr++;
+			while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+				ptr++;
+			}
+		}
+		if ((ptr < end) && ((*ptr == 'e') || (*ptr == 'E'))) {
+			is_real = true;
+			ptr++;
+			if ((ptr < end) && ((*ptr == '+') || (*ptr == '-'))) {
+				ptr++;
+			}
+			while ((ptr < end) && (*ptr >= '0') && (*ptr <= '9')) {
+				ptr++;
+			}
+		}
+
+		if (is_real) {
+			r_value = String::to_double(from);
+		} else {
+			// Negated in unsigned arithmetic, -INT64_MIN does not fit in int64.
+			r_value = (int64_t)(negative ? 0 - value : value);
+		}
+		return true;
+	}
+
+	bool parse_array(Variant &r_value) {
+		ptr++; // [
+		Array array;
+		skip_space();
+		if ((ptr < end) && (*ptr == ']')) {
+			ptr++;
+			r_value = array;
+			return true;
+		}
+		while (true) {
+			Variant item;
+			if (!parse_value(item)) {
+				return false;
+			}
+			array.push_back(item);
+			skip_space();
+			if (ptr == end) {
+				return fail("Unterminated array.");
+			}
+			CharType c = *ptr++;
+			if (c == ']') {
+				break;
+			}
+			if (c != ',') {
+				return fail("Expected ',' or ']'.");
+			}
+		}
+		r_value = array;
+		return true;
+	}
+
+	bool parse_object(Variant &r_value) {
+		ptr++; // {
+		Dictionary dict;
+		skip_space();
+		if ((ptr < end) && (*ptr == '}')) {
+			ptr++;
+			r_value = dict;
+			return true;
+		}
+		while (true) {
+			skip_space();
+			if ((ptr == end) || (*ptr != '"')) {
+				return fail("Expected object key.");
+			}
+			String key;
+			if (!parse_string(key)) {
+				return false;
+			}
+			skip_space();
+			if ((ptr == end) || (*ptr != ':')) {
+				return fail("Expected ':'.");
+			}
+			ptr++;
+			Variant item;
+			if (!parse_value(item)) {
+				return false;
+			}
+			dict[key] = item;
+			skip_space();
+			if (ptr == end) {
+				return fail("Unterminated object.");
+			}
+			CharType c = *ptr++;
+			if (c == '}') {
+				break;
+			}
+			if (c != ',') {
+				return fail("Expected ',' or '}'.");
+			}
+		}
+		r_value = dict;
+		return true;
+	}
+
+	bool parse_value(Variant &r_value) {
+		skip_space();
+		if (ptr == end) {
+			return fail("Unexpected end of input.");
+		}
+		switch (*ptr) {
+			case '{':
+			case '[': {
+				if (++depth > MAX_DEPTH) {
+					return fail("Nesting is too deep.");
+				}
+				bool ok = (*ptr == '{') ? parse_object(r_value) : parse_array(r_value);
+				depth--;
+				return ok;
+			}
+			case '"': {
+				String str;
+				if (!parse_string(str)) {
+					return false;
+				}
+				r_value = str;
+				return true;
+			}
+			case 't': {
+				return parse_literal("true", true, r_value);
+			}
+			case 'f': {
+				return parse_literal("false", false, r_value);
+			}
+			case 'n': {
+				return parse_literal("null", Variant(), r_value);
+			}
+			default: {
+				return parse_number(r_value);
+			}
+		}
+	}
+};
+
+Error WebViewJSON::decode(const String &p_json, Variant &r_value, String *r_error) {
+	WebViewJSONDecoder decoder(p_json.c_str(), p_json.length());
+	Variant value;
+	bool ok = decoder.parse_value(value);
+	if (ok) {
+		decoder.skip_space();
+		ok = decoder.at_end() || decoder.fail("Unexpected data after the value.");
+	}
+	if (!ok) {
+		if (r_error) {
+			*r_error = decoder.error;
+		}
+		return ERR_PARSE_ERROR;
+	}
+	r_value = value;
+	return OK;
+}
@@ -0,0 +1,24 @@
+/*************************************************************************/
+/*  webview_json.h                                                       */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_JSON_H
+#define WEB_VIEW_JSON_H
+
+#include "core/ustring.h"
+#include "core/variant.h"
+
+/*************************************************************************/
+
+// Single pass JSON decoder for the script messages and results. Values are
+// built directly from the source characters without an intermediate token
+// list, strings without escapes are copied in one step.
+//
+// Unlike JSON::parse, integers without fraction and exponent which fit in
+// int64 are decoded as int, other numbers as float.
+class WebViewJSON {
+public:
+	static Error decode(const String &p_json, Variant &r_value, String *r_error = nullptr);
+};
+
+#endif // WEB_VIEW_JSON_H
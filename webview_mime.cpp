@@ -0,0 +1,178 @@
+/*************************************************************************/
+/*  webview_mime.cpp                                                     */
+/*************************************************************************/
+
+#include "webview_mime.h"
+
+/*************************************************************************/
+
+struct WebViewMimeExtension {
+	const char *extension;
+	const char *type;
+};
+
+// Sorted by extension, lookup is a binary search.
+static const WebViewMimeExtension _mime_extensions[] = {
+	{ "avif", "image/avif" },
+	{ "bin", "application/octet-stream" },
+	{ "bmp", "image/bmp" },
+	{ "css", "text/css" },
+	{ "csv", "text/csv" },
+	{ "flac", "audio/flac" },
+	{ "gif", "image/gif" },
+	{ "glb", "model/gltf-binary" },
+	{ "gltf", "model/gltf+json" },
+	{ "htm", "text/html" },
+	{ "html", "text/html" },
+	{ "ico", "image/x-icon" },
+	{ "jpeg", "image/jpeg" },
+	{ "jpg", "image/jpeg" },
+	{ "js", "text/javascript" },
+	{ "json", "application/json" },
+	{ "m4a", "audio/mp4" },
+	{ "map", "application/json" },
+	{ "md", "text/markdown" },
+	{ "mjs", "text/javascript" },
+	{ "mp3", "audio/mpeg" },
+	{ "mp4", "video/mp4" },
+	{ "oga", "audio/ogg" },
+	{ "ogg", "audio/ogg" },
+	{ "ogv", "video/ogg" },
+	{ "opus", "audio/ogg" },
+	{ "otf", "font/otf" },
+	{ "pdf", "application/pdf" },
+	{ "png", "image/png" },
+	{ "svg", "image/svg+xml" },
+	{ "ttf", "font/ttf" },
+	{ "txt", "text/plain" },
+	{ "wasm", "application/wasm" },
+	{ "wav", "audio/wav" },
+	{ "webm", "video/webm" },
+	{ "webp", "image/webp" },
+	{ "woff", "font/woff" },
+	{ "woff2", "font/woff2" },
+	{ "xhtml", "application/xhtml+xml" },
+	{ "xml", "application/xml" },
+	{ "zip", "application/zip" },
+};
+
+struct WebViewMimeMagic {
+	int offset;
+	const char *bytes;
+	int size;
+	const char *type;
+};
+
+static const WebViewMimeMagic _mime_magic[] = {
+	{ 0, "\x89PNG\r\n\x1A\n", 8, "image/png" },
+	{ 0, "\xFF\xD8\xFF", 3, "image/jpeg" },
+	{ 0, "GIF87a", 6, "image/gif" },
+	{ 0, "GIF89a", 6, "image/gif" },
+	{ 8, "WEBP", 4, "image/webp" }, // RIFF container.
+	{ 8, "WAVE", 4, "audio/wav" }, // RIFF container.
+	{ 4, "ftypavif", 8, "image/avif" },
+	{ 4, "ftyp", 4, "video/mp4" },
+	{ 0, "BM", 2, "image/bmp" },
+	{ 0, "\x00\x00\x01\x00", 4, "image/x-icon" },
+	{ 0, "\x00" "asm", 4, "application/wasm" },
+	{ 0, "%PDF-", 5, "application/pdf" },
+	{ 0, "wOFF", 4, "font/woff" },
+	{ 0, "wOF2", 4, "font/woff2" },
+	{ 0, "OTTO", 4, "font/otf" },
+	{ 0, "\x00\x01\x00\x00", 4, "font/ttf" },
+	{ 0, "OggS", 4, "audio/ogg" },
+	{ 0, "fLaC", 4, "audio/flac" },
+	{ 0, "ID3", 3, "audio/mpeg" },
+	{ 0, "\x1A\x45\xDF\xA3", 4, "video/webm" },
+	{ 0, "glTF", 4, "model/gltf-binary" },
+	{ 0, "PK\x03\x04", 4, "application/zip" },
+};
+
+struct WebViewMimeMarkup {
+	const char *tag;
+	const char *type;
+};
+
+// Markup is recognized after the optional byte order mark and whitespace, case insensitive.
+static const WebViewMimeMarkup _mime_markup[] = {
+	{ "<!doctype html", "text/html" },
+	{ "<html", "text/html" },
+	{ "<svg", "image/svg+xml" },
+	{ "<?xml", "application/xml" },
+};
+
+static inline char _mime_lower(uint8_t p_char) {
+	return ((p_char >= 'A') && (p_char <= 'Z')) ? (char)(p_char + ('a' - 'A')) : (char)p_char;
+}
+
+/*************************************************************************/
+
+String WebViewMimeResolver::get_extension_type(const String &p_path) {
+	String extension = p_path.get_extension().to_lower();
+	if (extension.empty()) {
+		return String();
+	}
+	CharString ext = extension.utf8();
+
+	int low = 0;
+	int high = sizeof(_mime_extensions) / sizeof(_mime_extensions[0]) - 1;
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		int cmp = strcmp(ext.get_data(), _mime_extensions[mid].extension);
+		if (cmp == 0) {
+			return _mime_extensions[mid].type;
+		} else if (cmp < 0) {
+			high = mid - 1;
+		} else {
+			low = mid + 1;
+		}
+	}
+	return String();
+}
+
+String WebViewMimeResolver::get_magic_type(const uint8_t *p_header, int p_size) {
+	if ((p_header == nullptr) || (p_size <= 0)) {
+		return String();
+	}
+
+	for (unsigned int i = 0; i < sizeof(_mime_magic) / sizeof(_mime_magic[0]); i++) {
+		const WebViewMimeMagic &magic = _mime_magic[i];
+		if ((magic.offset + magic.size <= p_size) && (memcmp(p_header + magic.offset, magic.bytes, magic.size) == 0)) {
+			return magic.type;
+		}
+	}
+
+	int pos = 0;
+	if ((p_size >= 3) && (p_header[0] == 0xEF) && (p_header[1] == 0xBB) && (p_header[2] == 0xBF)) {
+		pos = 3;
+	}
+	while ((pos < p_size) && ((p_header[pos] == ' ') || (p_header[pos] == '\t') || (p_header[pos] == '\r') || (p_header[pos] == '\n'))) {
+		pos++;
+	}
+	for (unsigned int i = 0; i < sizeof(_mime_markup) / sizeof(_mime_markup[0]); i++) {
+		const char *tag = _mime_markup[i].tag;
+		int len = strlen(tag);
+		if (pos + len > p_size) {
+			continue;
+		}
+		int j = 0;
+		while ((j < len) && (_mime_lower(p_header[pos + j]) == tag[j])) {
+			j++;
+		}
+		if (j == len) {
+			return _mime_markup[i].type;
+		}
+	}
+	return String();
+}
+
+String WebViewMimeResolver::resolve(const String &p_path, const uint8_t *p_header, int p_size) {
+	String type = get_extension_type(p_path);
+	if (type.empty()) {
+		type = get_magic_type(p_header, p_size);
+	}
+	if (type.empty()) {
+		type = "application/octet-stream";
+	}
+	return type;
+}
@@ -0,0 +1,27 @@
+/*************************************************************************/
+/*  webview_mime.h                                                       */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_MIME_H
+#define WEB_VIEW_MIME_H
+
+#include "core/ustring.h"
+
+/*************************************************************************/
+
+// MIME types of the local resources served to the page. Type is resolved from
+// the file extension, or from the magic bytes of the file header if the
+// extension is missing or unknown.
+class WebViewMimeResolver {
+public:
+	enum {
+		HEADER_SIZE = 32, // Bytes of the file header needed by the magic table.
+	};
+
+	static String get_extension_type(const String &p_path);
+	static String get_magic_type(const uint8_t *p_header, int p_size);
+	// p_header can be nullptr, if the file header is not known.
+	static String resolve(const String &p_path, const uint8_t *p_header, int p_size);
+};
+
+#endif // WEB_VIEW_MIME_H
@@ -0,0 +1,492 @@
+/*************************************************************************/
+/*  webview_mock.cpp                                                     */
+/*************************************************************************/
+
+#include "webview_mock.h"
+#include "webview_json.h"
+
+#include "core/io/json.h"
+#include "core/os/os.h"
+#include "core/project_settings.h"
+
+uint64_t WebViewOverlayMock::navigation_latency = 50000;
+uint64_t WebViewOverlayMock::script_latency = 1000;
+uint64_t WebViewOverlayMock::snapshot_latency = 16000;
+int WebViewOverlayMock::messages_per_navigation = 0;
+int WebViewOverlayMock::message_size = 64;
+int WebViewOverlayMock::rpc_calls_per_navigation = 0;
+int WebViewOverlayMock::rpc_batch_size = 64;
+uint64_t WebViewOverlayMock::fixed_step = 0;
+
+void WebViewOverlayMock::init_settings() {
+	navigation_latency = (int)GLOBAL_DEF("webview/mock/navigation_latency_ms", 50) * 1000;
+	script_latency = (int)GLOBAL_DEF("webview/mock/script_latency_ms", 1) * 1000;
+	snapshot_latency = (int)GLOBAL_DEF("webview/mock/snapshot_latency_ms", 16) * 1000;
+	messages_per_navigation = GLOBAL_DEF("webview/mock/messages_per_navigation", 0);
+	message_size = GLOBAL_DEF("webview/mock/message_size", 64);
+	rpc_calls_per_navigation = GLOBAL_DEF("webview/mock/rpc_calls_per_navigation", 0);
+	rpc_batch_size = MAX((int)GLOBAL_DEF("webview/mock/rpc_batch_size", 64), 1);
+	fixed_step = (int)GLOBAL_DEF("webview/mock/fixed_step_ms", 0) * 1000;
+}
+
+/*************************************************************************/
+
+void WebViewOverlayMock::_push_event(EventType p_type, uint64_t p_delay, const String &p_payload, int p_width, uint64_t p_request) {
+	if (events.empty()) {
+		last_ticks = OS::get_singleton()->get_ticks_usec();
+	}
+
+	Event ev;
+	ev.time = clock + p_delay;
+	ev.id = next_event_id++;
+	ev.type = p_type;
+	ev.navigation = navigation_id;
+	ev.payload = p_payload;
+	ev.width = p_width;
+	ev.request = p_request;
+
+	// Keep events sorted by time, events with the same time are dispatched in order of creation.
+	List<Event>::Element *E = events.back();
+	while (E && (E->get().time > ev.time)) {
+		E = E->prev();
+	}
+	if (E) {
+		events.insert_after(E, ev);
+	} else {
+		events.push_front(ev);
+	}
+
+	control->set_process_internal(true);
+}
+
+void WebViewOverlayMock::_start_navigation(const String &p_url, const String &p_title) {
+	navigation_id++;
+	title = p_title;
+
+	_push_event(EVENT_START_NAVIGATION, 0, p_url);
+	if (!document_start_script.empty()) {
+		exec_script(document_start_script);
+	}
+	_push_event(EVENT_FINISH_NAVIGATION, navigation_latency, p_url);
+	for (int i = 0; i < messages_per_navigation; i++) {
+		_push_event(EVENT_MESSAGE, navigation_latency, _make_message_payload(p_url));
+	}
+	for (int i = 0; i < rpc_calls_per_navigation; i += rpc_batch_size) {
+		Array calls;
+		for (int j = i; j < MIN(i + rpc_batch_size, rpc_calls_per_navigation); j++) {
+			Dictionary call;
+			call["id"] = ++rpc_seq;
+			call["method"] = "mock_rpc";
+			Array args;
+			args.push_back(j);
+			call["args"] = args;
+			calls.push_back(call);
+		}
+		Dictionary msg;
+		msg["type"] = "rpc";
+		msg["calls"] = calls;
+		msg["results"] = Array();
+		_push_event(EVENT_MESSAGE, navigation_latency, "__webview__:" + JSON::print(msg));
+	}
+}
+
+void WebViewOverlayMock::_answer_rpc(const String &p_batch) {
+	Variant parsed;
+	if ((WebViewJSON::decode(p_batch, parsed) != OK) || (parsed.get_type() != Variant::DICTIONARY)) {
+		return;
+	}
+	Array calls = Dictionary(parsed).get("calls", Array());
+	if (calls.empty()) {
+		return; // Results of the page calls, nothing to answer.
+	}
+
+	Array results;
+	for (int i = 0; i < calls.size(); i++) {
+		Dictionary call = calls[i];
+		Dictionary value;
+		value["method"] = call.get("method", String());
+		value["args"] = call.get("args", Array());
+		Dictionary res;
+		res["id"] = call.get("id", Variant());
+		res["result"] = value;
+		results.push_back(res);
+	}
+	Dictionary msg;
+	msg["type"] = "rpc";
+	msg["calls"] = Array();
+	msg["results"] = results;
+	_push_event(EVENT_MESSAGE, script_latency, "__webview__:" + JSON::print(msg));
+}
+
+String WebViewOverlayMock::_make_message_payload(const String &p_url) {
+	static const char pattern[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+
+	String prefix = "{\"seq\":" + itos(message_seq++) + ",\"url\":\"" + p_url.json_escape() + "\",\"data\":\"";
+	int len = MAX(message_size - prefix.length() - 2, 0);
+
+	String data;
+	data.resize(len + 1);
+	CharType *w = data.ptrw();
+	for (int i = 0; i < len; i++) {
+		w[i] = pattern[(i + message_seq) % (sizeof(pattern) - 1)];
+	}
+	w[len] = 0;
+
+	return prefix + data + "\"}";
+}
+
+// Shares the snapshot buffer with the mock, it is copied on write if the next
+// snapshot is generated before conversion is done.
+class WebViewMockSnapshotSource : public WebViewSnapshotSource {
+public:
+	Vector<uint8_t> pixels;
+
+	virtual const uint8_t *lock() {
+		return pixels.ptr();
+	}
+};
+
+void WebViewOverlayMock::_emit_snapshot(int p_width, uint64_t p_request) {
+	int width = (p_width > 0) ? p_width : MAX((int)bounds.size.width, 1);
+	int height = (bounds.size.width > 0) ? MAX((int)(bounds.size.height * width / bounds.size.width), 1) : width * 3 / 4;
+
+	// Deterministic pattern, depends on the page URL only. Pixels are premultiplied BGRA,
+	// like the browser engines produce, to exercise the conversion path.
+	uint32_t seed = get_url().hash();
+
+	snapshot_buffer.resize(width * height * 4);
+	uint8_t *dst = snapshot_buffer.ptrw();
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint8_t a = (no_background) ? ((x + y) & 0xFF) : 0xFF;
+			dst[0] = (((x ^ y) + (seed >> 16)) & 0xFF) * a / 255;
+			dst[1] = ((y + (seed >> 8)) & 0xFF) * a / 255;
+			dst[2] = ((x + seed) & 0xFF) * a / 255;
+			dst[3] = a;
+			dst += 4;
+		}
+	}
+
+	WebViewMockSnapshotSource *source = memnew(WebViewMockSnapshotSource);
+	source->format = WebViewPixels::FORMAT_BGRA8_PREMULTIPLIED;
+	source->width = width;
+	source->height = height;
+	source->stride = width * 4;
+	source->pixels = snapshot_buffer;
+	control->_snapshot_ready_source(p_request, source);
+}
+
+void WebViewOverlayMock::_dispatch(const Event &p_event) {
+	switch (p_event.type) {
+		case EVENT_START_NAVIGATION: {
+			if (p_event.navigation == navigation_id) {
+				loading = true;
+				control->_post_event(WebViewOverlay::INBOUND_START_NAVIGATION);
+			}
+		} break;
+		case EVENT_FINISH_NAVIGATION: {
+			if (p_event.navigation == navigation_id) {
+				loading = false;
+				control->_post_event(WebViewOverlay::INBOUND_FINISH_NAVIGATION);
+			}
+		} break;
+		case EVENT_MESSAGE: {
+			control->_post_event(WebViewOverlay::INBOUND_MESSAGE, p_event.payload);
+		} break;
+		case EVENT_NEW_WINDOW: {
+			control->_post_event(WebViewOverlay::INBOUND_NEW_WINDOW, p_event.payload);
+		} break;
+		case EVENT_SNAPSHOT: {
+			_emit_snapshot(p_event.width, p_event.request);
+		} break;
+		case EVENT_EVALUATE: {
+			Variant result;
+			if (WebViewJSON::decode(p_event.payload, result) != OK) {
+				result = Variant();
+			}
+			control->_script_evaluated(p_event.request, result);
+		} break;
+	}
+}
+
+/*************************************************************************/
+
+Error WebViewOverlayMock::create() {
+	created = true;
+	clock = 0;
+	last_ticks = OS::get_singleton()->get_ticks_usec();
+	return OK;
+}
+
+void WebViewOverlayMock::destroy() {
+	created = false;
+	loading = false;
+	events.clear();
+	document_start_script = String();
+	history.clear();
+	history_pos = -1;
+}
+
+bool WebViewOverlayMock::is_created() const {
+	return created;
+}
+
+bool WebViewOverlayMock::is_ready() const {
+	return created;
+}
+
+bool WebViewOverlayMock::needs_process() const {
+	return !events.empty();
+}
+
+void WebViewOverlayMock::process() {
+	if (fixed_step > 0) {
+		clock += fixed_step;
+	} else {
+		uint64_t ticks = OS::get_singleton()->get_ticks_usec();
+		clock += ticks - last_ticks;
+		last_ticks = ticks;
+	}
+
+	// Events scheduled by the signal handlers are dispatched on the next frame.
+	uint64_t last_id = next_event_id;
+	while (created && !events.empty() && (events.front()->get().time <= clock) && (events.front()->get().id < last_id)) {
+		Event ev = events.front()->get();
+		events.pop_front();
+		_dispatch(ev);
+	}
+}
+
+bool WebViewOverlayMock::is_offscreen() const {
+	return true;
+}
+
+void WebViewOverlayMock::set_bounds(const Rect2 &p_rect) {
+	bounds = p_rect;
+}
+
+void WebViewOverlayMock::set_visible(bool p_visible) {
+	visible = p_visible;
+}
+
+void WebViewOverlayMock::set_no_background(bool p_bg) {
+	no_background = p_bg;
+}
+
+void WebViewOverlayMock::set_user_agent(const String &p_user_agent) {
+	user_agent = p_user_agent;
+}
+
+String WebViewOverlayMock::get_user_agent() const {
+	return user_agent;
+}
+
+void WebViewOverlayMock::set_zoom_level(double p_zoom) {
+	zoom = p_zoom;
+}
+
+double WebViewOverlayMock::get_zoom_level() const {
+	return zoom;
+}
+
+static String _mock_find_title(const String &p_source) {
+	int from = p_source.find("<title>");
+	if (from != -1) {
+		int to = p_source.find("</title>", from);
+		if (to != -1) {
+			return p_source.substr(from + 7, to - from - 7);
+		}
+	}
+	return String();
+}
+
+String WebViewOverlayMock::_load_resource(const String &p_url) {
+	if (resource_reader.open(p_url) != OK) {
+		return p_url;
+	}
+	// Read in chunks like the native scheme handlers, title is taken from the first one.
+	String page_title = p_url;
+	const uint8_t *chunk = nullptr;
+	int len = resource_reader.read_chunk(&chunk);
+	if (len > 0) {
+		String head;
+		head.parse_utf8((const char *)chunk, len);
+		String found = _mock_find_title(head);
+		if (!found.empty()) {
+			page_title = found;
+		}
+	}
+	while (len > 0) {
+		len = resource_reader.read_chunk(&chunk);
+	}
+	resource_reader.close();
+	return page_title;
+}
+
+void WebViewOverlayMock::navigate(const String &p_url) {
+	history.resize(history_pos + 1);
+	history.push_back(p_url);
+	history_pos = history.size() - 1;
+
+	_start_navigation(p_url, WebViewResourceReader::is_local_url(p_url) ? _load_resource(p_url) : p_url);
+}
+
+String WebViewOverlayMock::get_url() const {
+	if (history_pos >= 0) {
+		return history[history_pos];
+	}
+	return String();
+}
+
+String WebViewOverlayMock::get_title() const {
+	return title;
+}
+
+void WebViewOverlayMock::load_string(const String &p_source) {
+	history.resize(history_pos + 1);
+	history.push_back("about:blank");
+	history_pos = history.size() - 1;
+
+	_start_navigation("about:blank", _mock_find_title(p_source));
+}
+
+static String _mock_script_argument(const String &p_script, int p_from, int &r_end) {
+	int depth = 1;
+	int pos = p_from;
+	CharType quote = 0;
+	while (pos < p_script.length()) {
+		CharType c = p_script[pos];
+		if (quote != 0) {
+			if (c == '\\') {
+				pos++;
+			} else if (c == quote) {
+				quote = 0;
+			}
+		} else if ((c == '"') || (c == '\'') || (c == '`')) {
+			quote = c;
+		} else if (c == '(') {
+			depth++;
+		} else if (c == ')') {
+			depth--;
+			if (depth == 0) {
+				break;
+			}
+		}
+		pos++;
+	}
+	r_end = pos;
+
+	String arg = p_script.substr(p_from, pos - p_from).strip_edges();
+	if ((arg.length() >= 2) && ((arg[0] == '"') || (arg[0] == '\'') || (arg[0] == '`')) && (arg[arg.length() - 1] == arg[0])) {
+		arg = arg.substr(1, arg.length() - 2).c_unescape();
+	}
+	return arg;
+}
+
+String WebViewOverlayMock::get_binary_endpoint() const {
+	return "webview-bin://binary/";
+}
+
+void WebViewOverlayMock::exec_script(const String &p_script) {
+	static const String message_call = "webviewMessage(";
+	static const String open_call = "window.open(";
+	static const String rpc_call = "__webviewRpcDeliver(";
+	static const String isolated_call = "try{(0,eval)(";
+	static const String binary_call = "__webviewBinaryFetch(";
+
+	if (p_script.begins_with(isolated_call)) {
+		// Batched or document-start scripts, sources are unescaped and scanned one by one.
+		int pos = 0;
+		while ((pos = p_script.find(isolated_call, pos)) != -1) {
+			exec_script(_mock_script_argument(p_script, pos + isolated_call.length(), pos));
+		}
+		return;
+	}
+	if (p_script.begins_with(binary_call)) {
+		// Page fetches the payload right away, URL is the last argument.
+		int end;
+		String args = _mock_script_argument(p_script, binary_call.length(), end);
+		String url = args.substr(args.rfind(",\"") + 2).trim_suffix("\"");
+		PoolByteArray payload;
+		WebViewOverlay::_binary_request(url.trim_prefix(get_binary_endpoint()), PoolByteArray(), payload);
+		return;
+	}
+	if (p_script.begins_with(rpc_call)) {
+		int end;
+		_answer_rpc(_mock_script_argument(p_script, rpc_call.length(), end));
+		return;
+	}
+
+	int pos = 0;
+	while (pos < p_script.length()) {
+		int msg = p_script.find(message_call, pos);
+		int opn = p_script.find(open_call, pos);
+		if ((msg == -1) && (opn == -1)) {
+			break;
+		}
+		if ((opn == -1) || ((msg != -1) && (msg < opn))) {
+			String arg = _mock_script_argument(p_script, msg + message_call.length(), pos);
+			_push_event(EVENT_MESSAGE, script_latency, arg);
+		} else {
+			String arg = _mock_script_argument(p_script, opn + open_call.length(), pos);
+			_push_event(EVENT_NEW_WINDOW, script_latency, arg.get_slice(",", 0).strip_edges().trim_prefix("\"").trim_suffix("\""));
+		}
+	}
+}
+
+void WebViewOverlayMock::evaluate_script(const String &p_script, uint64_t p_id) {
+	exec_script(p_script);
+	_push_event(EVENT_EVALUATE, script_latency, p_script.strip_edges(), 0, p_id);
+}
+
+void WebViewOverlayMock::set_document_start_script(const String &p_source) {
+	document_start_script = p_source;
+}
+
+void WebViewOverlayMock::capture(int p_width, uint64_t p_id) {
+	_push_event(EVENT_SNAPSHOT, snapshot_latency, String(), p_width, p_id);
+}
+
+bool WebViewOverlayMock::can_go_back() const {
+	return history_pos > 0;
+}
+
+bool WebViewOverlayMock::can_go_forward() const {
+	return history_pos < history.size() - 1;
+}
+
+bool WebViewOverlayMock::is_loading() const {
+	return loading;
+}
+
+bool WebViewOverlayMock::is_secure_content() const {
+	return get_url().begins_with("https://");
+}
+
+void WebViewOverlayMock::go_back() {
+	if (can_go_back()) {
+		history_pos--;
+		_start_navigation(history[history_pos], history[history_pos]);
+	}
+}
+
+void WebViewOverlayMock::go_forward() {
+	if (can_go_forward()) {
+		history_pos++;
+		_start_navigation(history[history_pos], history[history_pos]);
+	}
+}
+
+void WebViewOverlayMock::reload() {
+	if (history_pos >= 0) {
+		_start_navigation(history[history_pos], title);
+	}
+}
+
+void WebViewOverlayMock::stop() {
+	navigation_id++;
+	if (loading) {
+		loading = false;
+		control->_post_event(WebViewOverlay::INBOUND_FINISH_NAVIGATION);
+	}
+}
@@ -0,0 +1,135 @@
+/*************************************************************************/
+/*  webview_mock.h                                                       */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_MOCK_H
+#define WEB_VIEW_MOCK_H
+
+#include "webview_backend.h"
+#include "webview_resource.h"
+
+#include "core/list.h"
+
+/*************************************************************************/
+
+// Browser-less backend, simulates navigation, script messages and snapshots with
+// configurable latencies ("webview/mock/*" project settings). With non-zero
+// "webview/mock/fixed_step_ms" simulation clock advances by a fixed step every
+// frame, which makes event order and timing independent of the frame rate.
+//
+// Scripts passed to execute_java_script are not evaluated, "webviewMessage(...)"
+// and "window.open(...)" calls are recognized and emit callback / new_window.
+// Document-start script is handled the same way on every navigation.
+// Local (res:// and user://) pages are read with the shared resource reader,
+// the title is taken from the page source.
+// Scripts passed to evaluate_java_script evaluate to their value if they are
+// JSON literals, null otherwise.
+//
+// Script calls delivered by the control are answered by the mock page in one
+// batch, the result is {method, args} of the call. With non-zero
+// "webview/mock/rpc_calls_per_navigation" the page calls the "mock_rpc"
+// control method after every navigation, in batches of "webview/mock/rpc_batch_size".
+class WebViewOverlayMock : public WebViewOverlayImplementation {
+	enum EventType {
+		EVENT_START_NAVIGATION,
+		EVENT_FINISH_NAVIGATION,
+		EVENT_MESSAGE,
+		EVENT_NEW_WINDOW,
+		EVENT_SNAPSHOT,
+		EVENT_EVALUATE,
+	};
+
+	struct Event {
+		uint64_t time = 0;
+		uint64_t id = 0;
+		EventType type = EVENT_MESSAGE;
+		uint64_t navigation = 0;
+		String payload;
+		int width = 0;
+		uint64_t request = 0;
+	};
+
+	static uint64_t navigation_latency;
+	static uint64_t script_latency;
+	static uint64_t snapshot_latency;
+	static int messages_per_navigation;
+	static int message_size;
+	static int rpc_calls_per_navigation;
+	static int rpc_batch_size;
+	static uint64_t fixed_step;
+
+	List<Event> events;
+	uint64_t clock = 0;
+	uint64_t last_ticks = 0;
+	uint64_t next_event_id = 0;
+	uint64_t navigation_id = 0;
+	uint32_t message_seq = 0;
+	uint32_t rpc_seq = 0;
+
+	bool created = false;
+	bool loading = false;
+	bool no_background = false;
+	bool visible = true;
+	double zoom = 1.0;
+	String user_agent;
+	String title;
+	String document_start_script;
+	Rect2 bounds;
+
+	Vector<uint8_t> snapshot_buffer;
+
+	WebViewResourceReader resource_reader;
+
+	Vector<String> history;
+	int history_pos = -1;
+
+	void _push_event(EventType p_type, uint64_t p_delay, const String &p_payload = String(), int p_width = 0, uint64_t p_request = 0);
+	void _start_navigation(const String &p_url, const String &p_title);
+	void _dispatch(const Event &p_event);
+	String _make_message_payload(const String &p_url);
+	void _answer_rpc(const String &p_batch);
+	String _load_resource(const String &p_url);
+	void _emit_snapshot(int p_width, uint64_t p_request);
+
+public:
+	virtual Error create();
+	virtual void destroy();
+	virtual bool is_created() const;
+	virtual bool is_ready() const;
+
+	virtual void process();
+	virtual bool needs_process() const;
+
+	virtual bool is_offscreen() const;
+	virtual void set_bounds(const Rect2 &p_rect);
+	virtual void set_visible(bool p_visible);
+
+	virtual void set_no_background(bool p_bg);
+	virtual void set_user_agent(const String &p_user_agent);
+	virtual String get_user_agent() const;
+	virtual void set_zoom_level(double p_zoom);
+	virtual double get_zoom_level() const;
+
+	virtual void navigate(const String &p_url);
+	virtual String get_url() const;
+	virtual String get_title() const;
+	virtual void load_string(const String &p_source);
+	virtual void exec_script(const String &p_script);
+	virtual void evaluate_script(const String &p_script, uint64_t p_id);
+	virtual String get_binary_endpoint() const;
+	virtual void set_document_start_script(const String &p_source);
+	virtual void capture(int p_width, uint64_t p_id);
+
+	virtual bool can_go_back() const;
+	virtual bool can_go_forward() const;
+	virtual bool is_loading() const;
+	virtual bool is_secure_content() const;
+	virtual void go_back();
+	virtual void go_forward();
+	virtual void reload();
+	virtual void stop();
+
+	static void init_settings();
+};
+
+#endif // WEB_VIEW_MOCK_H
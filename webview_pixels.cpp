@@ -0,0 +1,392 @@
+/*************************************************************************/
+/*  webview_pixels.cpp                                                   */
+/*************************************************************************/
+
+#include "webview_pixels.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define WEBVIEW_PIXELS_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define WEBVIEW_PIXELS_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define WEBVIEW_AVX2_FUNC
+#else
+#define WEBVIEW_AVX2_FUNC __attribute__((target("avx2")))
+#endif
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define WEBVIEW_PIXELS_NEON
+#include <arm_neon.h>
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define WEBVIEW_PIXELS_NEON_DIV // Vector float division is AArch64 only.
+#endif
+#endif
+
+/*************************************************************************/
+/*  Scalar kernels                                                       */
+/*************************************************************************/
+
+enum AlphaMode {
+	ALPHA_STRAIGHT,
+	ALPHA_PREMULTIPLIED,
+	ALPHA_OPAQUE,
+};
+
+static _FORCE_INLINE_ uint8_t _unpremultiply(uint32_t p_c, uint32_t p_a) {
+	uint32_t v = (p_c * 255 + (p_a >> 1)) / ((p_a != 0) ? p_a : 1);
+	return (v > 255) ? 255 : v;
+}
+
+template <bool BGR, AlphaMode MODE>
+static void _convert_row_scalar(const uint8_t *p_src, uint8_t *p_dst, int p_width) {
+	for (int x = 0; x < p_width; x++) {
+		uint8_t r = p_src[BGR ? 2 : 0];
+		uint8_t g = p_src[1];
+		uint8_t b = p_src[BGR ? 0 : 2];
+		uint8_t a = (MODE == ALPHA_OPAQUE) ? 255 : p_src[3];
+		if ((MODE == ALPHA_PREMULTIPLIED) && (a != 255)) {
+			r = _unpremultiply(r, a);
+			g = _unpremultiply(g, a);
+			b = _unpremultiply(b, a);
+		}
+		p_dst[0] = r;
+		p_dst[1] = g;
+		p_dst[2] = b;
+		p_dst[3] = a;
+		p_src += 4;
+		p_dst += 4;
+	}
+}
+
+static void _copy_row(const uint8_t *p_src, uint8_t *p_dst, int p_width) {
+	memcpy(p_dst, p_src, p_width * 4);
+}
+
+static bool _equal_scalar(const uint8_t *p_a, const uint8_t *p_b, int p_width) {
+	return memcmp(p_a, p_b, p_width * 4) == 0;
+}
+
+/*************************************************************************/
+/*  SSE2 kernels, 4 pixels per iteration                                 */
+/*************************************************************************/
+
+#ifdef WEBVIEW_PIXELS_SSE2
+
+// Swaps bytes 0 and 2 of every pixel.
+static _FORCE_INLINE_ __m128i _swizzle_sse2(__m128i p_v) {
+	const __m128i mask_ag = _mm_set1_epi32(0xFF00FF00);
+	const __m128i mask_rb = _mm_set1_epi32(0x00FF00FF);
+	__m128i rb = _mm_and_si128(p_v, mask_rb);
+	return _mm_or_si128(_mm_and_si128(p_v, mask_ag), _mm_or_si128(_mm_srli_epi32(rb, 16), _mm_slli_epi32(rb, 16)));
+}
+
+static _FORCE_INLINE_ __m128i _unpremultiply_sse2(__m128i p_c, __m128 p_a, __m128i p_half_a) {
+	const __m128 max = _mm_set1_ps(255.f);
+	__m128i n = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(p_c, 8), p_c), p_half_a); // c * 255 + a / 2
+	return _mm_cvttps_epi32(_mm_min_ps(_mm_div_ps(_mm_cvtepi32_ps(n), p_a), max));
+}
+
+template <bool BGR, AlphaMode MODE>
+static void _convert_row_sse2(const uint8_t *p_src, uint8_t *p_dst, int p_width) {
+	const __m128i mask_a = _mm_set1_epi32(0xFF000000);
+	const __m128i mask_c = _mm_set1_epi32(0xFF);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i zero = _mm_setzero_si128();
+
+	int x = 0;
+	for (; x + 4 <= p_width; x += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p_src + x * 4));
+		if (MODE == ALPHA_OPAQUE) {
+			v = _mm_or_si128(v, mask_a);
+		} else if (MODE == ALPHA_PREMULTIPLIED) {
+			__m128i va = _mm_and_si128(v, mask_a);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(va, mask_a)) != 0xFFFF) {
+				__m128i a = _mm_srli_epi32(v, 24);
+				__m128i a1 = _mm_or_si128(a, _mm_and_si128(_mm_cmpeq_epi32(a, zero), one));
+				__m128 af = _mm_cvtepi32_ps(a1);
+				__m128i half_a = _mm_srli_epi32(a, 1);
+				__m128i c0 = _unpremultiply_sse2(_mm_and_si128(v, mask_c), af, half_a);
+				__m128i c1 = _unpremultiply_sse2(_mm_and_si128(_mm_srli_epi32(v, 8), mask_c), af, half_a);
+				__m128i c2 = _unpremultiply_sse2(_mm_and_si128(_mm_srli_epi32(v, 16), mask_c), af, half_a);
+				v = _mm_or_si128(_mm_or_si128(c0, _mm_slli_epi32(c1, 8)), _mm_or_si128(_mm_slli_epi32(c2, 16), va));
+			}
+		}
+		if (BGR) {
+			v = _swizzle_sse2(v);
+		}
+		_mm_storeu_si128((__m128i *)(p_dst + x * 4), v);
+	}
+	_convert_row_scalar<BGR, MODE>(p_src + x * 4, p_dst + x * 4, p_width - x);
+}
+
+static bool _equal_sse2(const uint8_t *p_a, const uint8_t *p_b, int p_width) {
+	int x = 0;
+	__m128i diff = _mm_setzero_si128();
+	for (; x + 4 <= p_width; x += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(p_a + x * 4));
+		__m128i b = _mm_loadu_si128((const __m128i *)(p_b + x * 4));
+		diff = _mm_or_si128(diff, _mm_xor_si128(a, b));
+	}
+	if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF) {
+		return false;
+	}
+	return _equal_scalar(p_a + x * 4, p_b + x * 4, p_width - x);
+}
+#endif
+
+/*************************************************************************/
+/*  AVX2 kernels, 8 pixels per iteration, selected at runtime            */
+/*************************************************************************/
+
+#ifdef WEBVIEW_PIXELS_AVX2
+
+static bool _has_avx2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || ((_xgetbv(0) & 0x6) != 0x6)) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+WEBVIEW_AVX2_FUNC static _FORCE_INLINE_ __m256i _unpremultiply_avx2(__m256i p_c, __m256 p_a, __m256i p_half_a) {
+	const __m256 max = _mm256_set1_ps(255.f);
+	__m256i n = _mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(p_c, 8), p_c), p_half_a); // c * 255 + a / 2
+	return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_div_ps(_mm256_cvtepi32_ps(n), p_a), max));
+}
+
+template <bool BGR, AlphaMode MODE>
+WEBVIEW_AVX2_FUNC static void _convert_row_avx2(const uint8_t *p_src, uint8_t *p_dst, int p_width) {
+	const __m256i mask_a = _mm256_set1_epi32(0xFF000000);
+	const __m256i mask_c = _mm256_set1_epi32(0xFF);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i swizzle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	int x = 0;
+	for (; x + 8 <= p_width; x += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p_src + x * 4));
+		if (MODE == ALPHA_OPAQUE) {
+			v = _mm256_or_si256(v, mask_a);
+		} else if (MODE == ALPHA_PREMULTIPLIED) {
+			__m256i va = _mm256_and_si256(v, mask_a);
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(va, mask_a)) != -1) {
+				__m256i a = _mm256_srli_epi32(v, 24);
+				__m256 af = _mm256_cvtepi32_ps(_mm256_max_epi32(a, one));
+				__m256i half_a = _mm256_srli_epi32(a, 1);
+				__m256i c0 = _unpremultiply_avx2(_mm256_and_si256(v, mask_c), af, half_a);
+				__m256i c1 = _unpremultiply_avx2(_mm256_and_si256(_mm256_srli_epi32(v, 8), mask_c), af, half_a);
+				__m256i c2 = _unpremultiply_avx2(_mm256_and_si256(_mm256_srli_epi32(v, 16), mask_c), af, half_a);
+				v = _mm256_or_si256(_mm256_or_si256(c0, _mm256_slli_epi32(c1, 8)), _mm256_or_si256(_mm256_slli_epi32(c2, 16), va));
+			}
+		}
+		if (BGR) {
+			v = _mm256_shuffle_epi8(v, swizzle);
+		}
+		_mm256_storeu_si256((__m256i *)(p_dst + x * 4), v);
+	}
+	_convert_row_scalar<BGR, MODE>(p_src + x * 4, p_dst + x * 4, p_width - x);
+}
+
+
+WEBVIEW_AVX2_FUNC static bool _equal_avx2(const uint8_t *p_a, const uint8_t *p_b, int p_width) {
+	int x = 0;
+	__m256i diff = _mm256_setzero_si256();
+	for (; x + 8 <= p_width; x += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(p_a + x * 4));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(p_b + x * 4));
+		diff = _mm256_or_si256(diff, _mm256_xor_si256(a, b));
+	}
+	if (!_mm256_testz_si256(diff, diff)) {
+		return false;
+	}
+	return _equal_scalar(p_a + x * 4, p_b + x * 4, p_width - x);
+}
+#endif
+
+/*************************************************************************/
+/*  NEON kernels, 16 pixels per iteration (4 when comparing)             */
+/*************************************************************************/
+
+#ifdef WEBVIEW_PIXELS_NEON
+
+#ifdef WEBVIEW_PIXELS_NEON_DIV
+static _FORCE_INLINE_ uint32x4_t _unpremultiply_neon_4(uint16x4_t p_n, uint16x4_t p_a) {
+	float32x4_t q = vdivq_f32(vcvtq_f32_u32(vmovl_u16(p_n)), vcvtq_f32_u32(vmovl_u16(p_a)));
+	return vcvtq_u32_f32(vminq_f32(q, vdupq_n_f32(255.f)));
+}
+
+static _FORCE_INLINE_ uint8x16_t _unpremultiply_neon(uint8x16_t p_c, uint8x16_t p_a) {
+	uint16x8_t a_lo = vmovl_u8(vget_low_u8(p_a));
+	uint16x8_t a_hi = vmovl_u8(vget_high_u8(p_a));
+	uint16x8_t n_lo = vmlaq_n_u16(vshrq_n_u16(a_lo, 1), vmovl_u8(vget_low_u8(p_c)), 255); // c * 255 + a / 2
+	uint16x8_t n_hi = vmlaq_n_u16(vshrq_n_u16(a_hi, 1), vmovl_u8(vget_high_u8(p_c)), 255);
+	a_lo = vmaxq_u16(a_lo, vdupq_n_u16(1));
+	a_hi = vmaxq_u16(a_hi, vdupq_n_u16(1));
+
+	uint16x8_t r_lo = vcombine_u16(vmovn_u32(_unpremultiply_neon_4(vget_low_u16(n_lo), vget_low_u16(a_lo))), vmovn_u32(_unpremultiply_neon_4(vget_high_u16(n_lo), vget_high_u16(a_lo))));
+	uint16x8_t r_hi = vcombine_u16(vmovn_u32(_unpremultiply_neon_4(vget_low_u16(n_hi), vget_low_u16(a_hi))), vmovn_u32(_unpremultiply_neon_4(vget_high_u16(n_hi), vget_high_u16(a_hi))));
+	return vcombine_u8(vmovn_u16(r_lo), vmovn_u16(r_hi));
+}
+#endif
+
+template <bool BGR, AlphaMode MODE>
+static void _convert_row_neon(const uint8_t *p_src, uint8_t *p_dst, int p_width) {
+	int x = 0;
+	for (; x + 16 <= p_width; x += 16) {
+		uint8x16x4_t v = vld4q_u8(p_src + x * 4);
+		if (MODE == ALPHA_OPAQUE) {
+			v.val[3] = vdupq_n_u8(255);
+		} else if (MODE == ALPHA_PREMULTIPLIED) {
+#ifdef WEBVIEW_PIXELS_NEON_DIV
+			if (vminvq_u8(v.val[3]) != 255) {
+				v.val[0] = _unpremultiply_neon(v.val[0], v.val[3]);
+				v.val[1] = _unpremultiply_neon(v.val[1], v.val[3]);
+				v.val[2] = _unpremultiply_neon(v.val[2], v.val[3]);
+			}
+#endif
+		}
+		if (BGR) {
+			uint8x16_t t = v.val[0];
+			v.val[0] = v.val[2];
+			v.val[2] = t;
+		}
+		vst4q_u8(p_dst + x * 4, v);
+	}
+	_convert_row_scalar<BGR, MODE>(p_src + x * 4, p_dst + x * 4, p_width - x);
+}
+
+static bool _equal_neon(const uint8_t *p_a, const uint8_t *p_b, int p_width) {
+	int x = 0;
+	uint8x16_t diff = vdupq_n_u8(0);
+	for (; x + 4 <= p_width; x += 4) {
+		diff = vorrq_u8(diff, veorq_u8(vld1q_u8(p_a + x * 4), vld1q_u8(p_b + x * 4)));
+	}
+	uint64x2_t d = vreinterpretq_u64_u8(diff);
+	if ((vgetq_lane_u64(d, 0) | vgetq_lane_u64(d, 1)) != 0) {
+		return false;
+	}
+	return _equal_scalar(p_a + x * 4, p_b + x * 4, p_width - x);
+}
+
+#endif
+
+/*************************************************************************/
+
+typedef void (*ConvertRowFunc)(const uint8_t *p_src, uint8_t *p_dst, int p_width);
+typedef bool (*EqualFunc)(const uint8_t *p_a, const uint8_t *p_b, int p_width);
+
+struct ConvertKernels {
+	const char *name;
+	ConvertRowFunc funcs[WebViewPixels::FORMAT_MAX];
+	EqualFunc equal;
+};
+
+#define WEBVIEW_KERNELS(m_name, m_func, m_equal)                                                           \
+	{                                                                                                      \
+		m_name, {                                                                                          \
+			_copy_row, m_func<true, ALPHA_STRAIGHT>, m_func<false, ALPHA_PREMULTIPLIED>,                   \
+					m_func<true, ALPHA_PREMULTIPLIED>, m_func<false, ALPHA_OPAQUE>, m_func<true, ALPHA_OPAQUE> \
+		},                                                                                                 \
+				m_equal                                                                                    \
+	}
+
+#if !defined(WEBVIEW_PIXELS_SSE2) && !defined(WEBVIEW_PIXELS_NEON)
+static const ConvertKernels _kernels_scalar = WEBVIEW_KERNELS("scalar", _convert_row_scalar, _equal_scalar);
+#endif
+#ifdef WEBVIEW_PIXELS_SSE2
+static const ConvertKernels _kernels_sse2 = WEBVIEW_KERNELS("SSE2", _convert_row_sse2, _equal_sse2);
+#endif
+#ifdef WEBVIEW_PIXELS_AVX2
+static const ConvertKernels _kernels_avx2 = WEBVIEW_KERNELS("AVX2", _convert_row_avx2, _equal_avx2);
+#endif
+#ifdef WEBVIEW_PIXELS_NEON
+#ifdef WEBVIEW_PIXELS_NEON_DIV
+static const ConvertKernels _kernels_neon = WEBVIEW_KERNELS("NEON", _convert_row_neon, _equal_neon);
+#else
+// No vector division, un-premultiply with scalar code.
+static const ConvertKernels _kernels_neon = {
+	"NEON", { _copy_row, _convert_row_neon<true, ALPHA_STRAIGHT>, _convert_row_scalar<false, ALPHA_PREMULTIPLIED>, _convert_row_scalar<true, ALPHA_PREMULTIPLIED>, _convert_row_neon<false, ALPHA_OPAQUE>, _convert_row_neon<true, ALPHA_OPAQUE> }, _equal_neon
+};
+#endif
+#endif
+
+static const ConvertKernels *_select_kernels() {
+#ifdef WEBVIEW_PIXELS_AVX2
+	if (_has_avx2()) {
+		return &_kernels_avx2;
+	}
+#endif
+#if defined(WEBVIEW_PIXELS_SSE2)
+	return &_kernels_sse2;
+#elif defined(WEBVIEW_PIXELS_NEON)
+	return &_kernels_neon;
+#else
+	return &_kernels_scalar;
+#endif
+}
+
+static const ConvertKernels *_kernels = _select_kernels();
+
+/*************************************************************************/
+
+void WebViewPixels::convert_to_rgba8(const uint8_t *p_src, int p_src_stride, Format p_format, uint8_t *p_dst, int p_width, int p_height) {
+	ERR_FAIL_INDEX(p_format, FORMAT_MAX);
+
+	ConvertRowFunc func = _kernels->funcs[p_format];
+	int dst_stride = p_width * 4;
+	if ((p_src_stride == dst_stride) && (p_format == FORMAT_RGBA8)) {
+		memcpy(p_dst, p_src, dst_stride * p_height);
+		return;
+	}
+	for (int y = 0; y < p_height; y++) {
+		func(p_src + y * p_src_stride, p_dst + y * dst_stride, p_width);
+	}
+}
+
+void WebViewPixels::compare_tiles(const uint8_t *p_a, const uint8_t *p_b, int p_width, int p_height, int p_tile_size, uint8_t *r_dirty) {
+	ERR_FAIL_COND(p_tile_size <= 0);
+
+	int tiles_x = (p_width + p_tile_size - 1) / p_tile_size;
+	int tiles_y = (p_height + p_tile_size - 1) / p_tile_size;
+	memset(r_dirty, 0, tiles_x * tiles_y);
+
+	EqualFunc equal = _kernels->equal;
+	int stride = p_width * 4;
+	for (int y = 0; y < p_height; y++) {
+		uint8_t *dirty = r_dirty + (y / p_tile_size) * tiles_x;
+		const uint8_t *a = p_a + y * stride;
+		const uint8_t *b = p_b + y * stride;
+		for (int tx = 0; tx < tiles_x; tx++) {
+			if (dirty[tx]) {
+				continue; // Already known to differ, skip the rest of the tile rows.
+			}
+			int x = tx * p_tile_size;
+			if (!equal(a + x * 4, b + x * 4, MIN(p_tile_size, p_width - x))) {
+				dirty[tx] = 1;
+			}
+		}
+	}
+}
+
+const char *WebViewPixels::get_kernel_name() {
+	return _kernels->name;
+}
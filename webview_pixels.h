@@ -0,0 +1,38 @@
+/*************************************************************************/
+/*  webview_pixels.h                                                     */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_PIXELS_H
+#define WEB_VIEW_PIXELS_H
+
+#include "core/error_macros.h"
+#include "core/typedefs.h"
+
+/*************************************************************************/
+
+// Conversion of the raw backend pixel buffers to Image::FORMAT_RGBA8 and
+// comparison of the converted snapshots.
+// Uses SSE2 / AVX2 (selected at runtime) or NEON kernels when available.
+class WebViewPixels {
+public:
+	enum Format {
+		FORMAT_RGBA8,
+		FORMAT_BGRA8,
+		FORMAT_RGBA8_PREMULTIPLIED,
+		FORMAT_BGRA8_PREMULTIPLIED,
+		FORMAT_RGBX8, // Alpha byte is ignored, pixels are opaque.
+		FORMAT_BGRX8,
+		FORMAT_MAX,
+	};
+
+	// Converts rows of p_src (p_src_stride bytes apart) to tightly packed straight alpha RGBA8.
+	static void convert_to_rgba8(const uint8_t *p_src, int p_src_stride, Format p_format, uint8_t *p_dst, int p_width, int p_height);
+
+	// Compares two tightly packed RGBA8 images of the same size in p_tile_size square
+	// tiles, sets r_dirty[ty * tiles_x + tx] to 1 for tiles that differ and 0 otherwise.
+	static void compare_tiles(const uint8_t *p_a, const uint8_t *p_b, int p_width, int p_height, int p_tile_size, uint8_t *r_dirty);
+
+	static const char *get_kernel_name();
+};
+
+#endif // WEB_VIEW_PIXELS_H
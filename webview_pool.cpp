@@ -0,0 +1,120 @@
+/*************************************************************************/
+/*  webview_pool.cpp                                                     */
+/*************************************************************************/
+
+#include "webview_pool.h"
+
+#include "webview_pixels.h"
+
+#include <string.h>
+
+PoolVector<uint8_t> WebViewSnapshotPool::take_buffer(int p_width, int p_height) {
+	MutexLock lock(mutex);
+
+	for (List<Buffer>::Element *E = buffers.front(); E; E = E->next()) {
+		if ((E->get().width == p_width) && (E->get().height == p_height)) {
+			PoolVector<uint8_t> data = E->get().data;
+			buffers.erase(E);
+			return data;
+		}
+	}
+	return PoolVector<uint8_t>();
+}
+
+Ref<Image> WebViewSnapshotPool::take_image() {
+	MutexLock lock(mutex);
+
+	if (images.empty()) {
+		Ref<Image> image;
+		image.instance();
+		return image;
+	}
+	Ref<Image> image = images.front()->get();
+	images.pop_front();
+	return image;
+}
+
+void WebViewSnapshotPool::recycle(const Ref<Image> &p_image) {
+	ERR_FAIL_COND(p_image.is_null());
+	ERR_FAIL_COND(p_image->empty());
+	{
+		MutexLock lock(mutex);
+		ERR_FAIL_COND_MSG(images.find(p_image) != nullptr, "Image is already in the pool.");
+	}
+
+	Buffer buffer;
+	buffer.width = p_image->get_width();
+	buffer.height = p_image->get_height();
+	buffer.data = p_image->get_data();
+	bool reuse_data = (p_image->get_format() == Image::FORMAT_RGBA8) && !p_image->has_mipmaps();
+
+	// Release the image reference to the pixels, so the buffer can be written without a copy.
+	p_image->create(1, 1, false, Image::FORMAT_L8);
+
+	MutexLock lock(mutex);
+
+	if (reuse_data) {
+		buffers.push_front(buffer);
+		while (buffers.size() > MAX_BUFFERS) {
+			buffers.pop_back();
+		}
+	}
+	if (images.size() < MAX_IMAGES) {
+		images.push_back(p_image);
+	}
+}
+
+void WebViewSnapshotPool::clear() {
+	MutexLock lock(mutex);
+
+	buffers.clear();
+	images.clear();
+}
+
+bool WebViewSnapshotPool::update_reference(ReferenceChannel p_channel, const uint8_t *p_pixels, int p_width, int p_height, int p_tile_size, uint8_t *r_dirty) {
+	ERR_FAIL_INDEX_V(p_channel, REFERENCE_MAX, false);
+	MutexLock lock(reference_mutex);
+
+	Buffer &reference = references[p_channel];
+	int size = p_width * p_height * 4;
+	bool same_size = (reference.width == p_width) && (reference.height == p_height) && (reference.data.size() == size);
+	if (!same_size) {
+		reference.width = p_width;
+		reference.height = p_height;
+		reference.data.resize(size);
+	}
+
+	PoolVector<uint8_t>::Write w = reference.data.write();
+	if (same_size) {
+		WebViewPixels::compare_tiles(w.ptr(), p_pixels, p_width, p_height, p_tile_size, r_dirty);
+	}
+	memcpy(w.ptr(), p_pixels, size);
+	return same_size;
+}
+
+void WebViewSnapshotPool::clear_reference(ReferenceChannel p_channel) {
+	ERR_FAIL_INDEX(p_channel, REFERENCE_MAX);
+	MutexLock lock(reference_mutex);
+
+	references[p_channel] = Buffer();
+}
+
+void WebViewSnapshotPool::clear_references() {
+	MutexLock lock(reference_mutex);
+
+	for (int i = 0; i < REFERENCE_MAX; i++) {
+		references[i] = Buffer();
+	}
+}
+
+int WebViewSnapshotPool::get_buffer_count() const {
+	MutexLock lock(mutex);
+
+	return buffers.size();
+}
+
+int WebViewSnapshotPool::get_image_count() const {
+	MutexLock lock(mutex);
+
+	return images.size();
+}
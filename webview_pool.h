@@ -0,0 +1,67 @@
+/*************************************************************************/
+/*  webview_pool.h                                                       */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_POOL_H
+#define WEB_VIEW_POOL_H
+
+#include "core/image.h"
+#include "core/list.h"
+#include "core/os/mutex.h"
+#include "core/reference.h"
+
+/*************************************************************************/
+
+// Reusable snapshot pixel buffers (keyed by dimensions) and Image objects of a
+// single view. Shared with the snapshot worker jobs, which take buffers once
+// the capture size is known, all methods are thread safe.
+class WebViewSnapshotPool : public Reference {
+public:
+	enum ReferenceChannel {
+		REFERENCE_SNAPSHOT,
+		REFERENCE_STREAM,
+		REFERENCE_MAX,
+	};
+
+private:
+	enum {
+		MAX_BUFFERS = 8,
+		MAX_IMAGES = 8,
+	};
+
+	struct Buffer {
+		int width = 0;
+		int height = 0;
+		PoolVector<uint8_t> data;
+	};
+
+	mutable Mutex mutex;
+	List<Buffer> buffers; // Most recently returned first.
+	List<Ref<Image> > images;
+
+	// Owned copies, never shared with the pooled buffers or images.
+	Mutex reference_mutex;
+	Buffer references[REFERENCE_MAX];
+
+public:
+	// Returns a pooled buffer of the given dimensions or an empty one.
+	PoolVector<uint8_t> take_buffer(int p_width, int p_height);
+	// Returns a pooled Image object (without data) or a new one.
+	Ref<Image> take_image();
+
+	// Takes over the pixel buffer and Image object, image is empty after the call.
+	void recycle(const Ref<Image> &p_image);
+	void clear();
+
+	// Last converted frame of each channel, compared with the next one for delta detection.
+	// Compares RGBA8 p_pixels with the reference (see WebViewPixels::compare_tiles) and copies
+	// them into it. Returns false if the reference has other dimensions, r_dirty is not set then.
+	bool update_reference(ReferenceChannel p_channel, const uint8_t *p_pixels, int p_width, int p_height, int p_tile_size, uint8_t *r_dirty);
+	void clear_reference(ReferenceChannel p_channel);
+	void clear_references();
+
+	int get_buffer_count() const;
+	int get_image_count() const;
+};
+
+#endif // WEB_VIEW_POOL_H
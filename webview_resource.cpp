@@ -0,0 +1,272 @@
+/*************************************************************************/
+/*  webview_resource.cpp                                                 */
+/*************************************************************************/
+
+#include "webview_resource.h"
+#include "webview_mime.h"
+
+#include "core/io/file_access_pack.h"
+#include "core/os/memory.h"
+#include "core/project_settings.h"
+
+/*************************************************************************/
+
+// Files in the pack can't change, and the pack has no modification times.
+static uint64_t _resource_modified_time(const String &p_path) {
+	PackedData *pack = PackedData::get_singleton();
+	if (pack && !pack->is_disabled() && pack->has_path(p_path)) {
+		return 0;
+	}
+	return FileAccess::get_modified_time(p_path);
+}
+
+Mutex WebViewResourceCache::mutex;
+Map<String, WebViewResourceCache::Entry> WebViewResourceCache::entries;
+List<String> WebViewResourceCache::lru;
+uint64_t WebViewResourceCache::max_size = 16 * 1024 * 1024;
+uint64_t WebViewResourceCache::total_size = 0;
+uint64_t WebViewResourceCache::hits = 0;
+uint64_t WebViewResourceCache::misses = 0;
+
+void WebViewResourceCache::_remove(Map<String, Entry>::Element *p_entry) {
+	total_size -= p_entry->get().data.size();
+	lru.erase(p_entry->get().lru);
+	entries.erase(p_entry);
+}
+
+bool WebViewResourceCache::load(const String &p_path, Vector<uint8_t> &r_data) {
+	{
+		MutexLock lock(mutex);
+		if (!entries.has(p_path)) {
+			misses++;
+			return false;
+		}
+	}
+
+	// Queried outside of the lock, and only for cached paths (files which existed).
+	uint64_t modified_time = _resource_modified_time(p_path);
+
+	MutexLock lock(mutex);
+	Map<String, Entry>::Element *E = entries.find(p_path);
+	if (!E) {
+		misses++; // Removed in the meantime.
+		return false;
+	}
+	if (E->get().modified_time != modified_time) {
+		_remove(E); // File was changed.
+		misses++;
+		return false;
+	}
+	lru.move_to_back(E->get().lru);
+	r_data = E->get().data;
+	hits++;
+	return true;
+}
+
+bool WebViewResourceCache::can_store(uint64_t p_size) {
+	return (p_size <= max_size / 4);
+}
+
+void WebViewResourceCache::store(const String &p_path, uint64_t p_modified_time, const Vector<uint8_t> &p_data) {
+	ERR_FAIL_COND(!can_store(p_data.size()));
+	MutexLock lock(mutex);
+
+	Map<String, Entry>::Element *E = entries.find(p_path);
+	if (E) {
+		_remove(E); // Stored by another reader in the meantime, or changed.
+	}
+	while (!lru.empty() && (total_size + p_data.size() > max_size)) {
+		_remove(entries.find(lru.front()->get()));
+	}
+
+	Entry entry;
+	entry.modified_time = p_modified_time;
+	entry.data = p_data;
+	entry.lru = lru.push_back(p_path);
+	entries[p_path] = entry;
+	total_size += p_data.size();
+}
+
+void WebViewResourceCache::clear() {
+	MutexLock lock(mutex);
+	entries.clear();
+	lru.clear();
+	total_size = 0;
+}
+
+uint64_t WebViewResourceCache::get_hits() {
+	MutexLock lock(mutex);
+	return hits;
+}
+
+uint64_t WebViewResourceCache::get_misses() {
+	MutexLock lock(mutex);
+	return misses;
+}
+
+uint64_t WebViewResourceCache::get_total_size() {
+	MutexLock lock(mutex);
+	return total_size;
+}
+
+int WebViewResourceCache::get_entry_count() {
+	MutexLock lock(mutex);
+	return entries.size();
+}
+
+void WebViewResourceCache::init_settings() {
+	// Cached files are read to a Vector, a quarter of the budget must fit in int.
+	int max_size_mb = CLAMP((int)GLOBAL_DEF("webview/resource_cache/max_size_mb", 16), 0, 1024);
+	max_size = (uint64_t)max_size_mb * 1024 * 1024;
+}
+
+void WebViewResourceCache::finish() {
+	clear();
+}
+
+/*************************************************************************/
+
+bool WebViewResourceReader::is_local_url(const String &p_url) {
+	return p_url.begins_with("res://") || p_url.begins_with("user://");
+}
+
+String WebViewResourceReader::get_path(const String &p_url) {
+	String path = p_url;
+	int end = path.find_char('?');
+	if (end != -1) {
+		path = path.substr(0, end);
+	}
+	end = path.find_char('#');
+	if (end != -1) {
+		path = path.substr(0, end);
+	}
+
+	// Path is resolved below the scheme root, leading ".." are dropped.
+	int root = path.find("://") + 3;
+	return path.substr(0, root) + path.substr(root, path.length() - root).percent_decode().simplify_path();
+}
+
+Error WebViewResourceReader::open(const String &p_url) {
+	close();
+	ERR_FAIL_COND_V(!is_local_url(p_url), ERR_INVALID_PARAMETER);
+
+	path = get_path(p_url);
+	position = 0;
+
+	// Cached files are not opened.
+	if (WebViewResourceCache::load(path, cached)) {
+		size = cached.size();
+		from_cache = true;
+		return OK;
+	}
+
+	Error err;
+	file = FileAccess::open(path, FileAccess::READ, &err);
+	if (err != OK) {
+		file = nullptr;
+		return err;
+	}
+	size = file->get_len();
+
+	if (WebViewResourceCache::can_store(size)) {
+		// Modification time of missing files is not queried, it prints an error.
+		uint64_t modified_time = _resource_modified_time(path);
+		cached.resize(size);
+		if (file->get_buffer(cached.ptrw(), size) == (int)size) {
+			memdelete(file);
+			file = nullptr;
+			WebViewResourceCache::store(path, modified_time, cached);
+			from_cache = true;
+		} else {
+			cached = Vector<uint8_t>();
+			file->seek(0);
+		}
+	}
+	return OK;
+}
+
+void WebViewResourceReader::close() {
+	if (file != nullptr) {
+		memdelete(file);
+		file = nullptr;
+	}
+	cached = Vector<uint8_t>();
+	from_cache = false;
+	path = String();
+	size = 0;
+	position = 0;
+}
+
+bool WebViewResourceReader::is_open() const {
+	return (file != nullptr) || from_cache;
+}
+
+uint64_t WebViewResourceReader::get_size() const {
+	return size;
+}
+
+uint64_t WebViewResourceReader::get_position() const {
+	return position;
+}
+
+bool WebViewResourceReader::eof_reached() const {
+	return (position >= size);
+}
+
+String WebViewResourceReader::get_mime_type() {
+	ERR_FAIL_COND_V(!is_open(), String());
+
+	String type = WebViewMimeResolver::get_extension_type(path);
+	if (!type.empty()) {
+		return type;
+	}
+	if (from_cache) {
+		return WebViewMimeResolver::resolve(path, cached.ptr(), MIN(cached.size(), (int)WebViewMimeResolver::HEADER_SIZE));
+	}
+	// Header is peeked, chunks are read from the same position.
+	uint8_t header[WebViewMimeResolver::HEADER_SIZE];
+	int len = file->get_buffer(header, (int)MIN(size - position, (uint64_t)WebViewMimeResolver::HEADER_SIZE));
+	file->seek(position);
+	return WebViewMimeResolver::resolve(path, header, MAX(len, 0));
+}
+
+uint64_t WebViewResourceReader::read(uint8_t *p_buffer, uint64_t p_size) {
+	ERR_FAIL_COND_V(!is_open(), 0);
+
+	// At most one chunk per call, whatever the caller buffer size is.
+	int count = (int)MIN(MIN(p_size, size - position), (uint64_t)CHUNK_SIZE);
+	if (count == 0) {
+		return 0;
+	}
+	if (from_cache) {
+		memcpy(p_buffer, cached.ptr() + position, count);
+		position += count;
+		return count;
+	}
+	count = file->get_buffer(p_buffer, count);
+	if (count <= 0) {
+		position = size; // File was truncated, end the response.
+		return 0;
+	}
+	position += count;
+	return count;
+}
+
+int WebViewResourceReader::read_chunk(const uint8_t **r_data) {
+	if (from_cache) {
+		// Cached file is not copied, chunks point to it.
+		int count = (int)MIN(size - position, (uint64_t)CHUNK_SIZE);
+		*r_data = cached.ptr() + position;
+		position += count;
+		return count;
+	}
+	if (buffer.size() != CHUNK_SIZE) {
+		buffer.resize(CHUNK_SIZE);
+	}
+	*r_data = buffer.ptr();
+	return (int)read(buffer.ptrw(), CHUNK_SIZE);
+}
+
+WebViewResourceReader::~WebViewResourceReader() {
+	close();
+}
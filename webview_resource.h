@@ -0,0 +1,99 @@
+/*************************************************************************/
+/*  webview_resource.h                                                   */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_RESOURCE_H
+#define WEB_VIEW_RESOURCE_H
+
+#include "core/list.h"
+#include "core/map.h"
+#include "core/os/file_access.h"
+#include "core/os/mutex.h"
+#include "core/ustring.h"
+#include "core/vector.h"
+
+/*************************************************************************/
+
+// In-memory cache of the local resources, shared by all views and scheme
+// handler threads (all methods are thread safe). Entries are keyed by path and
+// file modification time, and evicted in LRU order when the total size exceeds
+// "webview/resource_cache/max_size_mb" (at most 1024). Files above a quarter
+// of the budget are not cached, they are streamed from the file.
+class WebViewResourceCache {
+	struct Entry {
+		uint64_t modified_time = 0;
+		Vector<uint8_t> data; // Shared with the readers serving it.
+		List<String>::Element *lru = nullptr;
+	};
+
+	static Mutex mutex;
+	static Map<String, Entry> entries;
+	static List<String> lru; // Least recently used first.
+	static uint64_t max_size;
+	static uint64_t total_size;
+	static uint64_t hits;
+	static uint64_t misses;
+
+	static void _remove(Map<String, Entry>::Element *p_entry);
+
+public:
+	// Entry is validated with the current modification time of the file.
+	static bool load(const String &p_path, Vector<uint8_t> &r_data);
+	static bool can_store(uint64_t p_size);
+	static void store(const String &p_path, uint64_t p_modified_time, const Vector<uint8_t> &p_data);
+	static void clear();
+
+	static uint64_t get_hits();
+	static uint64_t get_misses();
+	static uint64_t get_total_size();
+	static int get_entry_count();
+
+	static void init_settings();
+	static void finish();
+};
+
+/*************************************************************************/
+
+// Local resource (res:// and user:// URL) served to the page by the backend
+// scheme handlers. File is read in chunks, either to the caller buffer or to
+// the reader buffer, which is kept for the next files opened by the same reader.
+// Files which fit in WebViewResourceCache are read at once and served from it.
+class WebViewResourceReader {
+public:
+	enum {
+		CHUNK_SIZE = 64 * 1024,
+	};
+
+private:
+	FileAccess *file = nullptr;
+	String path;
+	uint64_t size = 0;
+	uint64_t position = 0;
+	Vector<uint8_t> buffer;
+	Vector<uint8_t> cached; // Whole file, if it is served from the cache.
+	bool from_cache = false;
+
+public:
+	static bool is_local_url(const String &p_url);
+	// Strips query and fragment, decodes the path and resolves "." and "..".
+	static String get_path(const String &p_url);
+
+	Error open(const String &p_url);
+	void close();
+	bool is_open() const;
+
+	uint64_t get_size() const;
+	uint64_t get_position() const;
+	bool eof_reached() const;
+	// Resolved with WebViewMimeResolver, the file header is read only if the extension is unknown.
+	String get_mime_type();
+
+	// Reads up to p_size bytes (at most CHUNK_SIZE), returns the number of bytes read (0 at the end of file).
+	uint64_t read(uint8_t *p_buffer, uint64_t p_size);
+	// Reads the next chunk to the reader buffer (or points to the cached file), r_data is valid until the next call.
+	int read_chunk(const uint8_t **r_data);
+
+	~WebViewResourceReader();
+};
+
+#endif // WEB_VIEW_RESOURCE_H
@@ -0,0 +1,248 @@
+/*************************************************************************/
+/*  webview_rpc.cpp                                                      */
+/*************************************************************************/
+
+#include "webview.h"
+#include "webview_backend.h"
+
+#include "core/io/json.h"
+#include "core/os/os.h"
+
+/*************************************************************************/
+
+// Calls in both directions are batched, page script posts the calls and
+// results of one microtask in a single control message {type: "rpc", calls,
+// results}, control delivers the calls and results of one frame in a single
+// __webviewRpcDeliver call.
+//
+// Call: {id, method, args}, result: {id, result} or {id, error}. Ids of the
+// control calls are strings, 64-bit ids do not fit in JS numbers.
+
+static const char *_rpc_bridge_script =
+		"(function(){"
+		"var seq=0,pending={},handlers={},calls=[],results=[],scheduled=false;"
+		"function flush(){scheduled=false;var m={type:\"rpc\",calls:calls,results:results};calls=[];results=[];webviewMessage(\"__webview__:\"+JSON.stringify(m));}"
+		"function schedule(){if(!scheduled){scheduled=true;Promise.resolve().then(flush);}}"
+		"function reply(id,r){results.push(r);r.id=id;schedule();}"
+		"window.webviewRpc={timeout:30000,"
+		"call:function(method){var args=Array.prototype.slice.call(arguments,1),id=++seq,timeout=this.timeout;"
+		"return new Promise(function(resolve,reject){"
+		"var timer=(timeout>0)?setTimeout(function(){delete pending[id];reject(new Error(\"RPC call timed out: \"+method));},timeout):0;"
+		"pending[id]={resolve:resolve,reject:reject,timer:timer};calls.push({id:id,method:String(method),args:args});schedule();});},"
+		"register:function(name,fn){if(fn){handlers[name]=fn;}else{delete handlers[name];}}};"
+		"window.__webviewRpcDeliver=function(batch){"
+		"var r=batch.results||[];for(var i=0;i<r.length;i++){var p=pending[r[i].id];if(!p){continue;}delete pending[r[i].id];clearTimeout(p.timer);"
+		"if(r[i].error!==undefined){p.reject(new Error(r[i].error));}else{p.resolve(r[i].result);}}"
+		"var c=batch.calls||[];c.forEach(function(call){"
+		"Promise.resolve().then(function(){var fn=handlers[call.method];if(!fn){throw new Error(\"Unknown method: \"+call.method);}return fn.apply(null,call.args||[]);}).then("
+		"function(v){reply(call.id,{result:(v===undefined)?null:v});},"
+		"function(e){reply(call.id,{error:String((e&&e.message)||e)});});});};"
+		"})();";
+
+String WebViewOverlay::_get_rpc_bridge_script() {
+	return _rpc_bridge_script;
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::register_script_method(const String &p_name, Object *p_target, const StringName &p_method) {
+	ERR_FAIL_COND(p_name.empty());
+	ERR_FAIL_NULL(p_target);
+
+	ScriptMethod method;
+	method.target = p_target->get_instance_id();
+	method.method = p_method;
+	script_methods[p_name] = method;
+}
+
+void WebViewOverlay::unregister_script_method(const String &p_name) {
+	script_methods.erase(p_name);
+}
+
+PoolStringArray WebViewOverlay::get_script_methods() const {
+	PoolStringArray names;
+	for (const Map<String, ScriptMethod>::Element *E = script_methods.front(); E; E = E->next()) {
+		names.push_back(E->key());
+	}
+	return names;
+}
+
+uint64_t WebViewOverlay::call_script_function(const String &p_function, const Array &p_args, double p_timeout) {
+	ERR_FAIL_COND_V(!is_ready() && !_can_queue_commands(), 0);
+
+	double timeout = (p_timeout < 0) ? script_call_timeout : p_timeout;
+	ScriptCall call;
+	if (timeout > 0) {
+		call.deadline = OS::get_singleton()->get_ticks_usec() + (uint64_t)(timeout * 1000000.0);
+		rpc_next_deadline = (rpc_next_deadline == 0) ? call.deadline : MIN(rpc_next_deadline, call.deadline);
+	}
+	uint64_t id = script_calls.insert(call);
+
+	Dictionary msg;
+	msg["id"] = itos((int64_t)id);
+	msg["method"] = p_function;
+	msg["args"] = p_args;
+	rpc_outbox_calls.push_back(msg);
+	rpc_calls_out++;
+
+	// Sent with the other calls of the frame, once the view is ready.
+	set_process_internal(true);
+	return id;
+}
+
+int WebViewOverlay::get_pending_script_calls() const {
+	return script_calls.size();
+}
+
+void WebViewOverlay::set_script_call_timeout(double p_timeout) {
+	ERR_FAIL_COND(p_timeout < 0);
+	script_call_timeout = p_timeout;
+}
+
+double WebViewOverlay::get_script_call_timeout() const {
+	return script_call_timeout;
+}
+
+Dictionary WebViewOverlay::get_script_call_stats() const {
+	Dictionary stats;
+	stats["calls_in"] = rpc_calls_in;
+	stats["calls_out"] = rpc_calls_out;
+	stats["batches_in"] = rpc_batches_in;
+	stats["batches_out"] = rpc_batches_out;
+	stats["timeouts"] = rpc_timeouts;
+	stats["pending"] = script_calls.size();
+	return stats;
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::_rpc_reply(const Variant &p_id, const Variant &p_result, const String &p_error) {
+	Dictionary msg;
+	msg["id"] = p_id;
+	if (p_error.empty()) {
+		msg["result"] = p_result;
+	} else {
+		msg["error"] = p_error;
+	}
+	rpc_outbox_results.push_back(msg);
+	set_process_internal(true);
+}
+
+void WebViewOverlay::_rpc_completed(const Variant &p_result, const Variant &p_id) {
+	// Completion of a yielded method, page may have been destroyed in the meantime.
+	if (is_ready()) {
+		_rpc_reply(p_id, p_result, String());
+	}
+}
+
+void WebViewOverlay::_rpc_message(const Dictionary &p_message) {
+	rpc_batches_in++;
+
+	Array results = p_message.get("results", Array());
+	for (int i = 0; i < results.size(); i++) {
+		Dictionary res = results[i];
+		uint64_t id = (uint64_t)String(res.get("id", String())).to_int64();
+		if (res.has("error")) {
+			_script_call_finished(id, Variant(), res["error"]);
+		} else {
+			_script_call_finished(id, res.get("result", Variant()), String());
+		}
+	}
+
+	Array calls = p_message.get("calls", Array());
+	for (int i = 0; i < calls.size(); i++) {
+		Dictionary call = calls[i];
+		Variant id = call.get("id", Variant());
+		String name = call.get("method", String());
+		Array args = call.get("args", Array());
+		rpc_calls_in++;
+
+		Map<String, ScriptMethod>::Element *E = script_methods.find(name);
+		if (!E) {
+			_rpc_reply(id, Variant(), "Unknown method: " + name);
+			continue;
+		}
+		Object *target = ObjectDB::get_instance(E->get().target);
+		if (!target) {
+			script_methods.erase(E);
+			_rpc_reply(id, Variant(), "Method target was freed: " + name);
+			continue;
+		}
+
+		Vector<const Variant *> argptrs;
+		argptrs.resize(args.size());
+		for (int j = 0; j < args.size(); j++) {
+			argptrs.write[j] = &args[j];
+		}
+		Variant::CallError ce;
+		Variant ret = target->call(E->get().method, argptrs.ptrw(), args.size(), ce);
+		if (ce.error != Variant::CallError::CALL_OK) {
+			_rpc_reply(id, Variant(), Variant::get_call_error_text(target, E->get().method, argptrs.ptrw(), args.size(), ce));
+			continue;
+		}
+
+		// Methods which yield return a function state, result is sent when it completes.
+		Object *state = ret;
+		if (state && state->has_signal("completed")) {
+			Vector<Variant> binds;
+			binds.push_back(id);
+			state->connect("completed", this, "_rpc_completed", binds, CONNECT_ONESHOT);
+			continue;
+		}
+		_rpc_reply(id, ret, String());
+	}
+}
+
+void WebViewOverlay::_script_call_finished(uint64_t p_id, const Variant &p_result, const String &p_error) {
+	if (!script_calls.erase(p_id)) {
+		return; // Timed out, or the view was destroyed.
+	}
+	emit_signal("script_call_completed", p_id, p_result, p_error);
+}
+
+void WebViewOverlay::_cancel_script_calls() {
+	List<uint64_t> ids;
+	script_calls.get_ids(&ids);
+	for (List<uint64_t>::Element *E = ids.front(); E; E = E->next()) {
+		_script_call_finished(E->get(), Variant(), "View was destroyed.");
+	}
+	rpc_outbox_calls.clear();
+	rpc_outbox_results.clear();
+	rpc_next_deadline = 0;
+}
+
+void WebViewOverlay::_process_rpc() {
+	if ((rpc_next_deadline != 0) && (OS::get_singleton()->get_ticks_usec() >= rpc_next_deadline)) {
+		uint64_t now = OS::get_singleton()->get_ticks_usec();
+		rpc_next_deadline = 0;
+
+		List<uint64_t> ids;
+		script_calls.get_ids(&ids);
+		for (List<uint64_t>::Element *E = ids.front(); E; E = E->next()) {
+			const ScriptCall *call = script_calls.get(E->get());
+			if (!call || (call->deadline == 0)) {
+				continue;
+			}
+			if (call->deadline <= now) {
+				rpc_timeouts++;
+				_script_call_finished(E->get(), Variant(), "Script call timed out.");
+			} else {
+				rpc_next_deadline = (rpc_next_deadline == 0) ? call->deadline : MIN(rpc_next_deadline, call->deadline);
+			}
+		}
+	}
+
+	if (rpc_outbox_calls.empty() && rpc_outbox_results.empty()) {
+		return;
+	}
+	Dictionary batch;
+	batch["calls"] = rpc_outbox_calls;
+	batch["results"] = rpc_outbox_results;
+	rpc_outbox_calls = Array();
+	rpc_outbox_results = Array();
+	rpc_batches_out++;
+
+	// Batched scripts run first, they may register the called functions.
+	_flush_script_batch();
+	data->exec_script("__webviewRpcDeliver(" + JSON::print(batch) + ");");
+}
@@ -0,0 +1,133 @@
+/*************************************************************************/
+/*  webview_script.cpp                                                   */
+/*************************************************************************/
+
+#include "webview.h"
+#include "webview_backend.h"
+#include "webview_json.h"
+
+/*************************************************************************/
+
+void WebViewOverlay::_update_document_scripts() {
+	// Scripts are isolated from each other's syntax errors and exceptions,
+	// sources registered under several names are included once.
+	String bundle;
+	Set<String> sources;
+	for (int i = 0; i < document_scripts.size(); i++) {
+		const DocumentScript &script = document_scripts[i];
+		if (sources.has(script.source)) {
+			continue;
+		}
+		sources.insert(script.source);
+		bundle += _make_isolated_script(script.source);
+	}
+	if (bundle == document_script_bundle) {
+		return;
+	}
+	document_script_bundle = bundle;
+
+	if (is_ready()) {
+		data->set_document_start_script(document_script_bundle);
+	}
+}
+
+void WebViewOverlay::add_document_start_script(const String &p_name, const String &p_source) {
+	ERR_FAIL_COND(p_name.empty());
+
+	for (int i = 0; i < document_scripts.size(); i++) {
+		if (document_scripts[i].name == p_name) {
+			if (document_scripts[i].source == p_source) {
+				return;
+			}
+			document_scripts.write[i].source = p_source;
+			_update_document_scripts();
+			return;
+		}
+	}
+	DocumentScript script;
+	script.name = p_name;
+	script.source = p_source;
+	document_scripts.push_back(script);
+	_update_document_scripts();
+}
+
+void WebViewOverlay::remove_document_start_script(const String &p_name) {
+	for (int i = 0; i < document_scripts.size(); i++) {
+		if (document_scripts[i].name == p_name) {
+			document_scripts.remove(i);
+			_update_document_scripts();
+			return;
+		}
+	}
+}
+
+PoolStringArray WebViewOverlay::get_document_start_scripts() const {
+	PoolStringArray names;
+	for (int i = 0; i < document_scripts.size(); i++) {
+		names.push_back(document_scripts[i].name);
+	}
+	return names;
+}
+
+/*************************************************************************/
+
+uint64_t WebViewOverlay::evaluate_java_script(const String &p_script) {
+	ERR_FAIL_COND_V(!is_ready() && !_can_queue_commands(), 0);
+
+	ScriptEvaluation eval;
+	eval.sent = is_ready();
+	uint64_t id = script_evaluations.insert(eval);
+
+	if (is_ready()) {
+		// Batched scripts run first, evaluated script may depend on them.
+		_flush_script_batch();
+		data->evaluate_script(p_script, id);
+	} else {
+		_queue_command(COMMAND_EVALUATE_SCRIPT, p_script, 0, id);
+	}
+	return id;
+}
+
+int WebViewOverlay::get_pending_evaluations() const {
+	return script_evaluations.size();
+}
+
+void WebViewOverlay::_cancel_script_evaluations(bool p_queued) {
+	List<uint64_t> ids;
+	script_evaluations.get_ids(&ids);
+	for (List<uint64_t>::Element *E = ids.front(); E; E = E->next()) {
+		if (p_queued || script_evaluations.get(E->get())->sent) {
+			_script_failed(E->get(), "View was destroyed.");
+		}
+	}
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::_script_evaluated(uint64_t p_id, const Variant &p_result) {
+	if (!script_evaluations.erase(p_id)) {
+		return;
+	}
+	emit_signal("script_evaluated", p_id, p_result, String());
+}
+
+void WebViewOverlay::_script_evaluated_json(uint64_t p_id, const String &p_json) {
+	if (!script_evaluations.has(p_id)) {
+		return;
+	}
+
+	Variant result;
+	String err_str;
+	if (WebViewJSON::decode(p_json, result, &err_str) != OK) {
+		_script_failed(p_id, "Can't decode script result: " + err_str);
+		return;
+	}
+	_script_evaluated(p_id, result);
+}
+
+void WebViewOverlay::_script_failed(uint64_t p_id, const String &p_error) {
+	if (!script_evaluations.erase(p_id)) {
+		return;
+	}
+	emit_signal("script_evaluated", p_id, Variant(), p_error);
+}
@@ -0,0 +1,107 @@
+/*************************************************************************/
+/*  webview_slot_map.h                                                   */
+/*************************************************************************/
+
+#ifndef WEB_VIEW_SLOT_MAP_H
+#define WEB_VIEW_SLOT_MAP_H
+
+#include "core/list.h"
+#include "core/vector.h"
+
+/*************************************************************************/
+
+// Generational slot map of the pending requests. Ids are the slot index and
+// generation, freed slots are reused with the next generation, so late
+// results of the removed requests do not match the new ones. Insertion,
+// lookup and removal are O(1).
+template <class T>
+class WebViewSlotMap {
+	struct Slot {
+		uint32_t generation = 1;
+		bool used = false;
+		T value;
+	};
+
+	Vector<Slot> slots;
+	Vector<uint32_t> free_slots;
+	int count = 0;
+
+	_FORCE_INLINE_ static uint64_t _make_id(uint32_t p_index, uint32_t p_generation) {
+		return ((uint64_t)p_generation << 32) | p_index;
+	}
+
+	_FORCE_INLINE_ int _find(uint64_t p_id) const {
+		uint32_t index = p_id & 0xFFFFFFFF;
+		if ((index >= (uint32_t)slots.size()) || !slots[index].used || (slots[index].generation != (uint32_t)(p_id >> 32))) {
+			return -1;
+		}
+		return index;
+	}
+
+public:
+	uint64_t insert(const T &p_value) {
+		uint32_t index;
+		if (free_slots.empty()) {
+			index = slots.size();
+			slots.push_back(Slot());
+		} else {
+			index = free_slots[free_slots.size() - 1];
+			free_slots.resize(free_slots.size() - 1);
+		}
+		Slot &slot = slots.write[index];
+		slot.used = true;
+		slot.value = p_value;
+		count++;
+		return _make_id(index, slot.generation);
+	}
+
+	T *get(uint64_t p_id) {
+		int index = _find(p_id);
+		return (index < 0) ? nullptr : &slots.write[index].value;
+	}
+
+	bool has(uint64_t p_id) const {
+		return _find(p_id) >= 0;
+	}
+
+	bool erase(uint64_t p_id) {
+		int index = _find(p_id);
+		if (index < 0) {
+			return false;
+		}
+		Slot &slot = slots.write[index];
+		slot.used = false;
+		slot.value = T();
+		// Generation 0 is skipped, so 0 is never a valid id.
+		slot.generation = MAX(slot.generation + 1, 1u);
+		free_slots.push_back(index);
+		count--;
+		return true;
+	}
+
+	void get_ids(List<uint64_t> *r_ids) const {
+		for (int i = 0; i < slots.size(); i++) {
+			if (slots[i].used) {
+				r_ids->push_back(_make_id(i, slots[i].generation));
+			}
+		}
+	}
+
+	void clear() {
+		List<uint64_t> ids;
+		get_ids(&ids);
+		for (List<uint64_t>::Element *E = ids.front(); E; E = E->next()) {
+			erase(E->get());
+		}
+	}
+
+	int size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+};
+
+#endif // WEB_VIEW_SLOT_MAP_H
@@ -0,0 +1,610 @@
+/*************************************************************************/
+/*  webview_snapshot.cpp                                                 */
+/*************************************************************************/
+
+#include "webview.h"
+#include "webview_backend.h"
+#include "webview_cache.h"
+
+#include "core/message_queue.h"
+#include "core/os/mutex.h"
+#include "core/os/os.h"
+#include "core/os/semaphore.h"
+#include "core/os/thread.h"
+#include "servers/visual_server.h"
+
+/*************************************************************************/
+
+// Snapshot decoding and conversion runs on a single worker thread shared by
+// all views, results are sent back to the control with a deferred call.
+struct WebViewSnapshotJob {
+	ObjectID control = 0;
+	uint64_t id = 0;
+	WebViewSnapshotSource *source = nullptr;
+	PoolVector<uint8_t> buffer;
+	Ref<WebViewSnapshotPool> pool;
+	int delta_channel = -1; // WebViewSnapshotPool::ReferenceChannel, or -1 if delta detection is disabled.
+};
+
+static Thread *snapshot_thread = nullptr;
+static Mutex snapshot_mutex;
+static Semaphore snapshot_semaphore;
+static List<WebViewSnapshotJob> snapshot_jobs;
+static bool snapshot_exit = false;
+
+// Merges dirty tiles into rectangles: horizontal runs of dirty tiles are extended
+// downwards while the next tile row has a run with the same extent.
+static Array _merge_dirty_tiles(const uint8_t *p_dirty, int p_tiles_x, int p_tiles_y, int p_tile_size, int p_width, int p_height) {
+	struct Run {
+		int x0, x1, y0, y1;
+	};
+	List<Run> open;
+	Array rects;
+
+	for (int ty = 0; ty <= p_tiles_y; ty++) {
+		List<Run> runs;
+		if (ty < p_tiles_y) {
+			const uint8_t *row = p_dirty + ty * p_tiles_x;
+			int tx = 0;
+			while (tx < p_tiles_x) {
+				if (!row[tx]) {
+					tx++;
+					continue;
+				}
+				Run run;
+				run.x0 = tx;
+				while ((tx < p_tiles_x) && row[tx]) {
+					tx++;
+				}
+				run.x1 = tx;
+				run.y0 = ty;
+				run.y1 = ty + 1;
+				runs.push_back(run);
+			}
+		}
+
+		for (List<Run>::Element *E = open.front(); E; E = E->next()) {
+			bool extended = false;
+			for (List<Run>::Element *F = runs.front(); F; F = F->next()) {
+				if ((F->get().x0 == E->get().x0) && (F->get().x1 == E->get().x1)) {
+					F->get().y0 = E->get().y0;
+					extended = true;
+					break;
+				}
+			}
+			if (!extended) {
+				const Run &r = E->get();
+				int x = r.x0 * p_tile_size;
+				int y = r.y0 * p_tile_size;
+				rects.push_back(Rect2(x, y, MIN(r.x1 * p_tile_size, p_width) - x, MIN(r.y1 * p_tile_size, p_height) - y));
+			}
+		}
+		open = runs;
+	}
+	return rects;
+}
+
+static Variant _compute_delta(WebViewSnapshotJob &p_job, const Ref<Image> &p_image) {
+	WebViewSnapshotPool::ReferenceChannel channel = (WebViewSnapshotPool::ReferenceChannel)p_job.delta_channel;
+	int width = p_image->get_width();
+	int height = p_image->get_height();
+	if ((p_image->get_format() != Image::FORMAT_RGBA8) || p_image->has_mipmaps()) {
+		p_job.pool->clear_reference(channel);
+		Array rects;
+		rects.push_back(Rect2(0, 0, width, height));
+		return rects;
+	}
+
+	const int tile_size = 32;
+	int tiles_x = (width + tile_size - 1) / tile_size;
+	int tiles_y = (height + tile_size - 1) / tile_size;
+	Vector<uint8_t> dirty;
+	dirty.resize(tiles_x * tiles_y);
+
+	bool compared;
+	{
+		// Pixels are copied to the pool reference, the image buffer is not shared with it.
+		PoolVector<uint8_t> pixels = p_image->get_data();
+		PoolVector<uint8_t>::Read r = pixels.read();
+		compared = p_job.pool->update_reference(channel, r.ptr(), width, height, tile_size, dirty.ptrw());
+	}
+	if (!compared) {
+		Array rects;
+		rects.push_back(Rect2(0, 0, width, height));
+		return rects;
+	}
+
+	return _merge_dirty_tiles(dirty.ptr(), tiles_x, tiles_y, tile_size, width, height);
+}
+
+static void _run_snapshot_job(WebViewSnapshotJob &p_job) {
+	Ref<Image> image;
+
+	WebViewSnapshotSource *source = p_job.source;
+	const uint8_t *src = source->lock();
+	if (src != nullptr) {
+		if (source->type == WebViewSnapshotSource::TYPE_PNG) {
+			image = Image::_png_mem_loader_func(src, source->size);
+		} else if ((source->width > 0) && (source->height > 0)) {
+			if ((p_job.buffer.size() == 0) && p_job.pool.is_valid()) {
+				p_job.buffer = p_job.pool->take_buffer(source->width, source->height);
+			}
+			p_job.buffer.resize(source->width * source->height * 4);
+			{
+				PoolVector<uint8_t>::Write w = p_job.buffer.write();
+				WebViewPixels::convert_to_rgba8(src, source->stride, source->format, w.ptr(), source->width, source->height);
+			}
+			if (p_job.pool.is_valid()) {
+				image = p_job.pool->take_image();
+				image->create(source->width, source->height, false, Image::FORMAT_RGBA8, p_job.buffer);
+			} else {
+				image = memnew(Image(source->width, source->height, false, Image::FORMAT_RGBA8, p_job.buffer));
+			}
+		}
+	}
+	memdelete(source);
+	p_job.buffer = PoolVector<uint8_t>();
+
+	Variant delta;
+	if (image.is_valid() && (p_job.delta_channel >= 0)) {
+		delta = _compute_delta(p_job, image);
+	}
+
+	if (image.is_valid()) {
+		MessageQueue::get_singleton()->push_call(p_job.control, "_snapshot_ready", p_job.id, image, delta);
+	} else {
+		MessageQueue::get_singleton()->push_call(p_job.control, "_snapshot_failed", p_job.id);
+	}
+}
+
+static void _snapshot_thread_func(void *p_ud) {
+	while (true) {
+		snapshot_semaphore.wait();
+
+		snapshot_mutex.lock();
+		if (snapshot_exit) {
+			snapshot_mutex.unlock();
+			break;
+		}
+		WebViewSnapshotJob job = snapshot_jobs.front()->get();
+		snapshot_jobs.pop_front();
+		snapshot_mutex.unlock();
+
+		_run_snapshot_job(job);
+	}
+}
+
+static void _push_snapshot_job(WebViewSnapshotJob &p_job) {
+	if (snapshot_thread == nullptr) {
+		_run_snapshot_job(p_job);
+		return;
+	}
+
+	snapshot_mutex.lock();
+	snapshot_jobs.push_back(p_job);
+	snapshot_mutex.unlock();
+	snapshot_semaphore.post();
+}
+
+void WebViewOverlay::_start_snapshot_worker() {
+	snapshot_exit = false;
+	snapshot_thread = Thread::create(_snapshot_thread_func, nullptr);
+}
+
+void WebViewOverlay::_stop_snapshot_worker() {
+	if (snapshot_thread == nullptr) {
+		return;
+	}
+
+	snapshot_mutex.lock();
+	snapshot_exit = true;
+	while (!snapshot_jobs.empty()) {
+		memdelete(snapshot_jobs.front()->get().source);
+		snapshot_jobs.pop_front();
+	}
+	snapshot_mutex.unlock();
+	snapshot_semaphore.post();
+
+	Thread::wait_to_finish(snapshot_thread);
+	memdelete(snapshot_thread);
+	snapshot_thread = nullptr;
+}
+
+/*************************************************************************/
+
+uint64_t WebViewOverlay::_request_capture(int p_width, bool p_stream, int p_slot, int p_tile) {
+	SnapshotRequest req;
+	req.width = p_width;
+	req.stream = p_stream;
+	req.slot = p_slot;
+	req.tile = p_tile;
+	if (snapshot_cache && !p_stream && (p_tile < 0)) {
+		req.cache = true;
+		req.url = get_url();
+		req.viewport = get_size();
+		req.fingerprint = snapshot_fingerprint;
+	}
+
+	uint64_t id = next_snapshot_id++;
+	snapshot_requests[id] = req;
+
+	if (is_ready()) {
+		data->capture(p_width, id);
+	} else {
+		_queue_command(COMMAND_CAPTURE, String(), p_width, id);
+	}
+	return id;
+}
+
+void WebViewOverlay::_clear_snapshot_requests() {
+	// Late results of the destroyed view are ignored.
+	snapshot_requests.clear();
+	snapshots_in_flight = 0;
+	snapshots_waiting.clear();
+	for (int i = 0; i < STREAM_RING_SIZE; i++) {
+		_release_stream_frame(stream_frames[i]);
+	}
+	stream_pending_delta = Array();
+	stream_full_upload = true;
+	if (full_page.active) {
+		_full_page_finish(false, false);
+	}
+}
+
+void WebViewOverlay::_snapshot_done(const SnapshotRequest &p_request) {
+	if (p_request.stream || (p_request.tile >= 0)) {
+		return;
+	}
+	snapshots_in_flight = MAX(snapshots_in_flight - 1, 0);
+	while ((snapshots_in_flight < max_snapshots_in_flight) && !snapshots_waiting.empty()) {
+		int width = snapshots_waiting.front()->get().width;
+		snapshots_waiting.pop_front();
+		snapshots_in_flight++;
+		_request_capture(width, false, -1);
+	}
+}
+
+void WebViewOverlay::_accumulate_stream_delta(const Variant &p_delta) {
+	if (p_delta.get_type() != Variant::ARRAY) {
+		stream_full_upload = true;
+		return;
+	}
+	Array rects = p_delta;
+	for (int i = 0; i < rects.size(); i++) {
+		stream_pending_delta.push_back(rects[i]);
+	}
+}
+
+void WebViewOverlay::_release_stream_frame(StreamFrame &p_frame) {
+	// Pixel buffer goes back to the slot once the image is gone, unless the
+	// image is still used elsewhere (e.g. kept from snapshot_delta).
+	Ref<Image> image = p_frame.image;
+	p_frame.image.unref();
+	if (image.is_valid() && (image->reference_get_count() == 1) && (image->get_format() == Image::FORMAT_RGBA8) && !image->has_mipmaps()) {
+		p_frame.data = image->get_data();
+	}
+	p_frame.delta = Variant();
+	p_frame.state = FRAME_FREE;
+}
+
+void WebViewOverlay::_process_stream() {
+	// Upload the most recent captured frame, older ones are dropped. Changed
+	// regions of the dropped frames are accumulated, since they were not uploaded.
+	int latest = -1;
+	for (int i = 0; i < STREAM_RING_SIZE; i++) {
+		if ((stream_frames[i].state == FRAME_READY) && ((latest == -1) || (stream_frames[i].seq > stream_frames[latest].seq))) {
+			latest = i;
+		}
+	}
+	for (int i = 0; i < STREAM_RING_SIZE; i++) {
+		if ((stream_frames[i].state == FRAME_READY) && (i != latest)) {
+			_accumulate_stream_delta(stream_frames[i].delta);
+			_release_stream_frame(stream_frames[i]);
+			stream_frames_dropped++;
+		}
+	}
+	if (latest != -1) {
+		StreamFrame &frame = stream_frames[latest];
+		_accumulate_stream_delta(frame.delta);
+
+		Ref<Image> image = frame.image;
+		if (stream_texture.is_null()) {
+			stream_texture.instance();
+		}
+		bool changed = true;
+		if ((stream_texture->get_width() != image->get_width()) || (stream_texture->get_height() != image->get_height()) || (stream_texture->get_format() != image->get_format())) {
+			stream_texture->create_from_image(image, Texture::FLAG_FILTER | Texture::FLAG_VIDEO_SURFACE);
+		} else if (stream_full_upload) {
+			stream_texture->set_data(image);
+		} else if (!stream_pending_delta.empty()) {
+			// Upload changed regions only.
+			VisualServer *vs = VisualServer::get_singleton();
+			for (int i = 0; i < stream_pending_delta.size(); i++) {
+				Rect2 rect = stream_pending_delta[i];
+				vs->texture_set_data_partial(stream_texture->get_rid(), image, rect.position.x, rect.position.y, rect.size.width, rect.size.height, rect.position.x, rect.position.y, 0);
+			}
+		} else {
+			changed = false;
+		}
+		if (changed && !stream_pending_delta.empty()) {
+			emit_signal("snapshot_delta", image, stream_pending_delta);
+		}
+		stream_full_upload = !delta_detection;
+		stream_pending_delta = Array();
+
+		image.unref();
+		_release_stream_frame(frame);
+		if (changed && data->is_offscreen()) {
+			update();
+		}
+	}
+
+	// Request the next frame, if every slot is in use the consumer lags and the frame is skipped.
+	uint64_t now = OS::get_singleton()->get_ticks_usec();
+	if (now < stream_next_capture) {
+		return;
+	}
+	uint64_t interval = (uint64_t)(1000000.0 / stream_fps);
+	stream_next_capture = MAX(stream_next_capture + interval, now);
+
+	for (int i = 0; i < STREAM_RING_SIZE; i++) {
+		if (stream_frames[i].state == FRAME_FREE) {
+			stream_frames[i].state = FRAME_PENDING;
+			stream_frames[i].seq = ++stream_seq;
+			_request_capture(MAX((int)get_size().width, 1), true, i);
+			return;
+		}
+	}
+	stream_frames_dropped++;
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::get_snapshot(int p_width) {
+	ERR_FAIL_COND(!is_ready() && !_can_queue_commands());
+
+	if (snapshot_cache) {
+		Ref<Image> image = WebViewSnapshotCache::load(get_url(), get_size(), p_width, snapshot_fingerprint);
+		if (image.is_valid()) {
+			call_deferred("emit_signal", "snapshot_ready", image);
+			return;
+		}
+	}
+
+	for (Map<uint64_t, SnapshotRequest>::Element *E = snapshot_requests.front(); E; E = E->next()) {
+		if (!E->get().stream && (E->get().tile < 0) && (E->get().width == p_width)) {
+			snapshots_merged++;
+			return;
+		}
+	}
+	for (List<SnapshotWaiting>::Element *E = snapshots_waiting.front(); E; E = E->next()) {
+		if (E->get().width == p_width) {
+			E->get().waiters++;
+			snapshots_merged++;
+			return;
+		}
+	}
+
+	if (snapshots_in_flight < max_snapshots_in_flight) {
+		snapshots_in_flight++;
+		_request_capture(p_width, false, -1);
+		return;
+	}
+
+	// Queue holds as many widths as can be in flight, the oldest waiting request is dropped.
+	if (snapshots_waiting.size() >= max_snapshots_in_flight) {
+		snapshots_dropped += snapshots_waiting.front()->get().waiters;
+		snapshots_waiting.pop_front();
+	}
+	SnapshotWaiting waiting;
+	waiting.width = p_width;
+	snapshots_waiting.push_back(waiting);
+}
+
+Ref<Texture> WebViewOverlay::get_texture() const {
+	if (streaming && stream_texture.is_valid()) {
+		return stream_texture;
+	}
+	if (data != nullptr) {
+		return data->get_texture();
+	}
+	return Ref<Texture>();
+}
+
+void WebViewOverlay::set_streaming(bool p_enabled) {
+	if (streaming == p_enabled) {
+		return;
+	}
+	streaming = p_enabled;
+	if (streaming) {
+		stream_next_capture = 0;
+		stream_frames_dropped = 0;
+		if (is_inside_tree() && _can_queue_commands()) {
+			set_process_internal(true);
+		}
+	} else {
+		// Captures in flight are detached from the ring, their results are discarded.
+		for (Map<uint64_t, SnapshotRequest>::Element *E = snapshot_requests.front(); E; E = E->next()) {
+			E->get().slot = -1;
+		}
+		for (int i = 0; i < STREAM_RING_SIZE; i++) {
+			_release_stream_frame(stream_frames[i]);
+		}
+		stream_pending_delta = Array();
+		stream_full_upload = true;
+	}
+	update();
+}
+
+bool WebViewOverlay::is_streaming() const {
+	return streaming;
+}
+
+void WebViewOverlay::set_stream_fps(double p_fps) {
+	ERR_FAIL_COND(p_fps <= 0.0);
+	stream_fps = p_fps;
+}
+
+double WebViewOverlay::get_stream_fps() const {
+	return stream_fps;
+}
+
+void WebViewOverlay::set_max_snapshots_in_flight(int p_max) {
+	ERR_FAIL_COND(p_max < 1);
+	max_snapshots_in_flight = p_max;
+}
+
+int WebViewOverlay::get_max_snapshots_in_flight() const {
+	return max_snapshots_in_flight;
+}
+
+void WebViewOverlay::recycle_snapshot(const Ref<Image> &p_image) {
+	snapshot_pool->recycle(p_image);
+}
+
+void WebViewOverlay::clear_snapshot_pool() {
+	snapshot_pool->clear();
+}
+
+void WebViewOverlay::set_snapshot_cache_enabled(bool p_enabled) {
+	snapshot_cache = p_enabled;
+}
+
+bool WebViewOverlay::is_snapshot_cache_enabled() const {
+	return snapshot_cache;
+}
+
+void WebViewOverlay::set_snapshot_fingerprint(const String &p_fingerprint) {
+	snapshot_fingerprint = p_fingerprint;
+}
+
+String WebViewOverlay::get_snapshot_fingerprint() const {
+	return snapshot_fingerprint;
+}
+
+Ref<Image> WebViewOverlay::get_cached_snapshot(const String &p_url, int p_width) {
+	return WebViewSnapshotCache::load(p_url, get_size(), p_width, snapshot_fingerprint);
+}
+
+void WebViewOverlay::clear_snapshot_cache() {
+	WebViewSnapshotCache::clear();
+}
+
+Dictionary WebViewOverlay::get_snapshot_stats() const {
+	Dictionary stats;
+	stats["in_flight"] = snapshots_in_flight;
+	stats["waiting"] = snapshots_waiting.size();
+	stats["merged"] = snapshots_merged;
+	stats["dropped"] = snapshots_dropped;
+	stats["pooled_buffers"] = snapshot_pool->get_buffer_count();
+	stats["pooled_images"] = snapshot_pool->get_image_count();
+	stats["cache_hits"] = WebViewSnapshotCache::get_hits();
+	stats["cache_misses"] = WebViewSnapshotCache::get_misses();
+	stats["cache_size"] = WebViewSnapshotCache::get_total_size();
+	return stats;
+}
+
+void WebViewOverlay::set_delta_detection(bool p_enabled) {
+	delta_detection = p_enabled;
+	if (!delta_detection) {
+		snapshot_pool->clear_references();
+		stream_full_upload = true;
+	}
+}
+
+bool WebViewOverlay::is_delta_detection_enabled() const {
+	return delta_detection;
+}
+
+int WebViewOverlay::get_stream_dropped_frames() const {
+	return (int)stream_frames_dropped;
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::_snapshot_ready_source(uint64_t p_id, WebViewSnapshotSource *p_source) {
+	ERR_FAIL_NULL(p_source);
+
+	Map<uint64_t, SnapshotRequest>::Element *E = snapshot_requests.find(p_id);
+	if (!E || (E->get().stream && (E->get().slot < 0))) {
+		memdelete(p_source);
+		if (E) {
+			_snapshot_failed(p_id);
+		}
+		return;
+	}
+
+	WebViewSnapshotJob job;
+	job.control = get_instance_id();
+	job.id = p_id;
+	job.source = p_source;
+	job.pool = snapshot_pool;
+	if (E->get().stream) {
+		// Ring buffer is moved to the job and returned with the converted image.
+		job.buffer = stream_frames[E->get().slot].data;
+		stream_frames[E->get().slot].data = PoolVector<uint8_t>();
+	}
+	if (E->get().tile >= 0) {
+		// Browser is done with the tile, scroll to the next one while this one is converted.
+		_full_page_tile_captured(E->get().tile);
+	} else if (delta_detection) {
+		job.delta_channel = (E->get().stream) ? WebViewSnapshotPool::REFERENCE_STREAM : WebViewSnapshotPool::REFERENCE_SNAPSHOT;
+	}
+	_push_snapshot_job(job);
+}
+
+void WebViewOverlay::_snapshot_ready(uint64_t p_id, const Ref<Image> &p_image, const Variant &p_delta) {
+	Map<uint64_t, SnapshotRequest>::Element *E = snapshot_requests.find(p_id);
+	if (!E) {
+		return;
+	}
+	SnapshotRequest req = E->get();
+	snapshot_requests.erase(E);
+	_snapshot_done(req);
+
+	if (req.stream) {
+		if (req.slot < 0) {
+			// Frame is discarded, but was used as the delta reference.
+			stream_full_upload = true;
+			if (!p_image->empty()) {
+				snapshot_pool->recycle(p_image);
+			}
+			return;
+		}
+		StreamFrame &frame = stream_frames[req.slot];
+		frame.image = p_image;
+		frame.delta = p_delta;
+		frame.state = FRAME_READY;
+		return;
+	}
+	if (req.tile >= 0) {
+		_full_page_tile_ready(req.tile, p_image);
+		return;
+	}
+
+	if (req.cache) {
+		WebViewSnapshotCache::store(req.url, req.viewport, req.width, req.fingerprint, p_image);
+	}
+	emit_signal("snapshot_ready", p_image);
+	if ((p_delta.get_type() == Variant::ARRAY) && !((Array)p_delta).empty()) {
+		emit_signal("snapshot_delta", p_image, p_delta);
+	}
+}
+
+void WebViewOverlay::_snapshot_failed(uint64_t p_id) {
+	Map<uint64_t, SnapshotRequest>::Element *E = snapshot_requests.find(p_id);
+	if (!E) {
+		return;
+	}
+	SnapshotRequest req = E->get();
+	snapshot_requests.erase(E);
+	_snapshot_done(req);
+
+	if (req.stream && (req.slot >= 0)) {
+		stream_frames[req.slot].state = FRAME_FREE;
+	}
+	if (req.tile >= 0) {
+		ERR_PRINT("Full-page snapshot tile capture failed.");
+		_full_page_finish(false, true);
+	}
+}
@@ -0,0 +1,347 @@
+/*************************************************************************/
+/*  webview_state.cpp                                                    */
+/*************************************************************************/
+
+#include "webview.h"
+#include "webview_backend.h"
+
+#include "core/io/json.h"
+
+/*************************************************************************/
+
+// Shared states are mirrored by the page script in webviewState[name]. Changes
+// of one frame are sent as patch operations in a single script:
+// [path, value] sets the value, [path] removes the dictionary key, empty path
+// replaces the whole state. Page script calls webviewOnState(name, callback)
+// listeners with the state and operations.
+
+static const char *_state_bridge_script =
+		"(function(){"
+		"var states={},listeners={};window.webviewState=states;"
+		"window.webviewOnState=function(name,callback){if(callback){listeners[name]=callback;}else{delete listeners[name];}};"
+		"window.__webviewStateApply=function(name,ops){"
+		"if(ops===null){delete states[name];return;}"
+		"for(var i=0;i<ops.length;i++){var op=ops[i],path=op[0];"
+		"if(path.length===0){states[name]=op[1];continue;}"
+		"if(states[name]==null){states[name]={};}"
+		"var o=states[name];for(var j=0;j<path.length-1;j++){if(o[path[j]]==null){o[path[j]]={};}o=o[path[j]];}"
+		"var k=path[path.length-1];if(op.length>1){o[k]=op[1];}else{delete o[k];}}"
+		"var cb=listeners[name];if(cb){cb(states[name],ops);}};"
+		"})();";
+
+String WebViewOverlay::_get_state_bridge_script() {
+	return _state_bridge_script;
+}
+
+/*************************************************************************/
+
+// Path components are type tagged and terminated, so the key of a parent is a
+// prefix of the keys of its children and sorts before them.
+static String _state_path_key(const Array &p_path) {
+	String key;
+	for (int i = 0; i < p_path.size(); i++) {
+		const Variant &v = p_path[i];
+		key += (v.get_type() == Variant::INT) ? ("i" + itos(v)) : ("s" + String(v));
+		key += String::chr(1);
+	}
+	return key;
+}
+
+static Variant _state_copy(const Variant &p_value) {
+	switch (p_value.get_type()) {
+		case Variant::DICTIONARY: {
+			return Dictionary(p_value).duplicate(true);
+		}
+		case Variant::ARRAY: {
+			return Array(p_value).duplicate(true);
+		}
+		default: {
+			return p_value;
+		}
+	}
+}
+
+void WebViewOverlay::_state_add_op(SharedState &p_state, const Array &p_path, const Variant &p_value, bool p_remove) {
+	if (p_state.full) {
+		return; // Whole state is sent anyway.
+	}
+	String key = _state_path_key(p_path);
+
+	// Pending operations on the children are overridden.
+	Map<String, Array>::Element *E = p_state.ops.find_closest(key);
+	E = E ? E->next() : p_state.ops.front();
+	while (E && E->key().begins_with(key)) {
+		Map<String, Array>::Element *N = E->next();
+		p_state.ops.erase(E);
+		E = N;
+	}
+
+	Array op;
+	op.push_back(p_path);
+	if (!p_remove) {
+		op.push_back(_state_copy(p_value));
+	}
+	p_state.ops[key] = op;
+}
+
+void WebViewOverlay::_state_diff(SharedState &p_state, const Variant &p_old, const Variant &p_new, Array &p_path) {
+	if (p_old.get_type() != p_new.get_type()) {
+		_state_add_op(p_state, p_path.duplicate(), p_new, false);
+		return;
+	}
+	switch (p_new.get_type()) {
+		case Variant::DICTIONARY: {
+			Dictionary old_dict = p_old;
+			Dictionary new_dict = p_new;
+			List<Variant> keys;
+			old_dict.get_key_list(&keys);
+			for (List<Variant>::Element *E = keys.front(); E; E = E->next()) {
+				if (!new_dict.has(E->get())) {
+					p_path.push_back(E->get());
+					_state_add_op(p_state, p_path.duplicate(), Variant(), true);
+					p_path.pop_back();
+				}
+			}
+			keys.clear();
+			new_dict.get_key_list(&keys);
+			for (List<Variant>::Element *E = keys.front(); E; E = E->next()) {
+				p_path.push_back(E->get());
+				if (old_dict.has(E->get())) {
+					_state_diff(p_state, old_dict[E->get()], new_dict[E->get()], p_path);
+				} else {
+					_state_add_op(p_state, p_path.duplicate(), new_dict[E->get()], false);
+				}
+				p_path.pop_back();
+			}
+		} break;
+		case Variant::ARRAY: {
+			// Arrays are patched by element only if their size is unchanged.
+			Array old_array = p_old;
+			Array new_array = p_new;
+			if (old_array.size() != new_array.size()) {
+				_state_add_op(p_state, p_path.duplicate(), p_new, false);
+				break;
+			}
+			for (int i = 0; i < new_array.size(); i++) {
+				p_path.push_back(i);
+				_state_diff(p_state, old_array[i], new_array[i], p_path);
+				p_path.pop_back();
+			}
+		} break;
+		default: {
+			if (p_old != p_new) {
+				_state_add_op(p_state, p_path.duplicate(), p_new, false);
+			}
+		} break;
+	}
+}
+
+void WebViewOverlay::_state_resolve(SharedState &p_state) {
+	if (!p_state.source_pending) {
+		return;
+	}
+	if (!p_state.full) {
+		Array path;
+		_state_diff(p_state, p_state.value, p_state.source, path);
+	}
+	p_state.value = Dictionary(p_state.source).duplicate(true);
+	p_state.source = Variant();
+	p_state.source_pending = false;
+}
+
+void WebViewOverlay::_state_changed() {
+	shared_states_dirty = true;
+	set_process_internal(true);
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::set_shared_state(const String &p_name, const Dictionary &p_state) {
+	ERR_FAIL_COND(p_name.empty());
+
+	Map<String, SharedState>::Element *E = shared_states.find(p_name);
+	if (!E) {
+		E = shared_states.insert(p_name, SharedState());
+		removed_shared_states.erase(p_name);
+	}
+	// Diffed once at the end of the frame, against the last state sent.
+	E->get().source = p_state;
+	E->get().source_pending = true;
+	_state_changed();
+}
+
+void WebViewOverlay::set_shared_value(const String &p_name, const Array &p_path, const Variant &p_value) {
+	Map<String, SharedState>::Element *E = shared_states.find(p_name);
+	ERR_FAIL_COND_MSG(!E, "Shared state does not exist: " + p_name + ".");
+	SharedState &state = E->get();
+	_state_resolve(state);
+
+	if (p_path.empty()) {
+		ERR_FAIL_COND(p_value.get_type() != Variant::DICTIONARY);
+		state.value = Dictionary(p_value).duplicate(true);
+		state.full = true;
+		state.ops.clear();
+		_state_changed();
+		return;
+	}
+
+	// Missing parents are created as dictionaries, like the page script does.
+	Variant parent = state.value;
+	for (int i = 0; i < p_path.size() - 1; i++) {
+		const Variant &key = p_path[i];
+		if (parent.get_type() == Variant::DICTIONARY) {
+			Dictionary dict = parent;
+			if (!dict.has(key) || (dict[key].get_type() == Variant::NIL)) {
+				dict[key] = Dictionary();
+			}
+			parent = dict[key];
+		} else if (parent.get_type() == Variant::ARRAY) {
+			Array array = parent;
+			ERR_FAIL_COND_MSG((key.get_type() != Variant::INT) || ((int)key < 0) || ((int)key >= array.size()), "Invalid shared state path.");
+			parent = array[(int)key];
+		} else {
+			ERR_FAIL_MSG("Invalid shared state path.");
+		}
+	}
+	const Variant &key = p_path[p_path.size() - 1];
+	if (parent.get_type() == Variant::DICTIONARY) {
+		Dictionary(parent)[key] = _state_copy(p_value);
+	} else if (parent.get_type() == Variant::ARRAY) {
+		Array array = parent;
+		ERR_FAIL_COND_MSG((key.get_type() != Variant::INT) || ((int)key < 0) || ((int)key >= array.size()), "Invalid shared state path.");
+		array[(int)key] = _state_copy(p_value);
+	} else {
+		ERR_FAIL_MSG("Invalid shared state path.");
+	}
+
+	_state_add_op(state, p_path.duplicate(), p_value, false);
+	_state_changed();
+}
+
+void WebViewOverlay::remove_shared_value(const String &p_name, const Array &p_path) {
+	Map<String, SharedState>::Element *E = shared_states.find(p_name);
+	ERR_FAIL_COND_MSG(!E, "Shared state does not exist: " + p_name + ".");
+	ERR_FAIL_COND(p_path.empty());
+	SharedState &state = E->get();
+	_state_resolve(state);
+
+	Variant parent = state.value;
+	for (int i = 0; i < p_path.size() - 1; i++) {
+		if (parent.get_type() == Variant::DICTIONARY) {
+			Dictionary dict = parent;
+			if (!dict.has(p_path[i])) {
+				return;
+			}
+			parent = dict[p_path[i]];
+		} else if (parent.get_type() == Variant::ARRAY) {
+			Array array = parent;
+			int index = p_path[i];
+			ERR_FAIL_INDEX(index, array.size());
+			parent = array[index];
+		} else {
+			return;
+		}
+	}
+	// Array elements are not removed, indices of the mirror would shift.
+	ERR_FAIL_COND_MSG(parent.get_type() != Variant::DICTIONARY, "Only dictionary keys can be removed from the shared state.");
+	Dictionary dict = parent;
+	if (!dict.erase(p_path[p_path.size() - 1])) {
+		return;
+	}
+
+	_state_add_op(state, p_path.duplicate(), Variant(), true);
+	_state_changed();
+}
+
+Dictionary WebViewOverlay::get_shared_state(const String &p_name) {
+	Map<String, SharedState>::Element *E = shared_states.find(p_name);
+	ERR_FAIL_COND_V(!E, Dictionary());
+	_state_resolve(E->get());
+	return E->get().value.duplicate(true);
+}
+
+void WebViewOverlay::remove_shared_state(const String &p_name) {
+	if (!shared_states.erase(p_name)) {
+		return;
+	}
+	removed_shared_states.insert(p_name);
+	_state_changed();
+}
+
+PoolStringArray WebViewOverlay::get_shared_state_names() const {
+	PoolStringArray names;
+	for (const Map<String, SharedState>::Element *E = shared_states.front(); E; E = E->next()) {
+		names.push_back(E->key());
+	}
+	return names;
+}
+
+Dictionary WebViewOverlay::get_shared_state_stats() const {
+	Dictionary stats;
+	stats["flushes"] = shared_state_flushes;
+	stats["full_syncs"] = shared_state_full_syncs;
+	stats["ops"] = shared_state_ops;
+	stats["bytes"] = shared_state_bytes;
+	return stats;
+}
+
+/*************************************************************************/
+
+void WebViewOverlay::_resync_shared_states() {
+	// Page was reloaded, mirrors are sent again in whole.
+	for (Map<String, SharedState>::Element *E = shared_states.front(); E; E = E->next()) {
+		E->get().full = true;
+		E->get().ops.clear();
+	}
+	removed_shared_states.clear();
+	if (!shared_states.empty()) {
+		_state_changed();
+	}
+}
+
+void WebViewOverlay::_flush_shared_states() {
+	if (!shared_states_dirty) {
+		return;
+	}
+	shared_states_dirty = false;
+
+	String script;
+	for (Set<String>::Element *E = removed_shared_states.front(); E; E = E->next()) {
+		script += "__webviewStateApply(\"" + E->get().json_escape() + "\",null);";
+	}
+	removed_shared_states.clear();
+
+	for (Map<String, SharedState>::Element *E = shared_states.front(); E; E = E->next()) {
+		SharedState &state = E->get();
+		_state_resolve(state);
+
+		Array ops;
+		if (state.full) {
+			Array op;
+			op.push_back(Array());
+			op.push_back(state.value);
+			ops.push_back(op);
+			state.full = false;
+			shared_state_full_syncs++;
+		} else {
+			for (Map<String, Array>::Element *O = state.ops.front(); O; O = O->next()) {
+				ops.push_back(O->get());
+			}
+			state.ops.clear();
+		}
+		if (ops.empty()) {
+			continue;
+		}
+		shared_state_ops += ops.size();
+		script += "__webviewStateApply(\"" + E->key().json_escape() + "\"," + JSON::print(ops) + ");";
+	}
+	if (script.empty()) {
+		return;
+	}
+	shared_state_flushes++;
+	shared_state_bytes += script.length();
+
+	// Batched scripts run first, the listeners may be registered by them.
+	_flush_script_batch();
+	data->exec_script(script);
+}
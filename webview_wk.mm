@@ -2,7 +2,8 @@
 /*  webview_wk.mm                                                        */
 /*************************************************************************/
 
-#include "webview.h"
+#include "webview_backend.h"
+#include "webview_resource.h"
 #include "core/os/os.h"
 
 #include <WebKit/WebKit.h>
@@ -17,6 +18,39 @@
 
 /*************************************************************************/
 
+// Converts script result (NSString, NSNumber, NSDate, NSArray, NSDictionary or NSNull) to Variant.
+static Variant _variant_from_ns(id p_object) {
+	if ((p_object == nil) || [p_object isKindOfClass:[NSNull class]]) {
+		return Variant();
+	} else if ([p_object isKindOfClass:[NSString class]]) {
+		return String::utf8([(NSString *)p_object UTF8String]);
+	} else if ([p_object isKindOfClass:[NSNumber class]]) {
+		NSNumber *number = (NSNumber *)p_object;
+		if (CFGetTypeID((CFTypeRef)number) == CFBooleanGetTypeID()) {
+			return (bool)[number boolValue];
+		}
+		return [number doubleValue];
+	} else if ([p_object isKindOfClass:[NSDate class]]) {
+		return [(NSDate *)p_object timeIntervalSince1970];
+	} else if ([p_object isKindOfClass:[NSArray class]]) {
+		Array result;
+		for (id item in (NSArray *)p_object) {
+			result.push_back(_variant_from_ns(item));
+		}
+		return result;
+	} else if ([p_object isKindOfClass:[NSDictionary class]]) {
+		Dictionary result;
+		NSDictionary *dict = (NSDictionary *)p_object;
+		for (id key in dict) {
+			result[_variant_from_ns(key)] = _variant_from_ns([dict objectForKey:key]);
+		}
+		return result;
+	}
+	return Variant();
+}
+
+/*************************************************************************/
+
 @interface GDWKNavigationDelegate: NSObject <WKNavigationDelegate, WKUIDelegate, WKScriptMessageHandler> {
 	WebViewOverlay *control;
 }
@@ -29,7 +63,7 @@
 	NSString *ns = [message body];
 	String url = String::utf8([ns UTF8String]);
 	if (control != nullptr) {
-		control->emit_signal("callback", url);
+		control->_post_event(WebViewOverlay::INBOUND_MESSAGE, url);
 	}
 }
 
@@ -38,7 +72,7 @@
 		NSURL *requestURL = navigationAction.request.URL;
 		NSString *ns = [requestURL absoluteString];
 		String url = String::utf8([ns UTF8String]);
-		control->emit_signal("new_window", url);
+		control->_post_event(WebViewOverlay::INBOUND_NEW_WINDOW, url);
 	}
 	return nil;
 }
@@ -49,13 +83,13 @@
 
 - (void)webView:(WKWebView *)webView didStartProvisionalNavigation:(WKNavigation *)navigation {
 	if (control != nullptr) {
-		control->emit_signal("start_navigation");
+		control->_post_event(WebViewOverlay::INBOUND_START_NAVIGATION);
 	}
 }
 
 - (void)webView:(WKWebView *)webView didFinishNavigation:(WKNavigation *)navigation {
 	if (control != nullptr) {
-		control->emit_signal("finish_navigation");
+		control->_post_event(WebViewOverlay::INBOUND_FINISH_NAVIGATION);
 	}
 }
 
@@ -65,8 +99,19 @@
 
 @interface GDWKURLSchemeHandler: NSObject <WKURLSchemeHandler> {
 	WebViewOverlay *control;
+	// Streamed document, the task receives the chunks as they are written.
+	NSString *stream_url;
+	id<WKURLSchemeTask> stream_task;
+	// Tasks are answered on the main thread one at a time, the chunk buffer is reused.
+	WebViewResourceReader *reader;
 }
 - (void)setControl:(WebViewOverlay *)p_control;
+- (void)beginStream:(NSString *)p_url;
+- (BOOL)canWriteStream;
+- (void)writeStream:(const CharString &)p_chunk;
+- (void)endStream;
+- (void)abortStream;
+- (void)answerBinaryTask:(id<WKURLSchemeTask>)urlSchemeTask;
 @end
 
 @implementation GDWKURLSchemeHandler
@@ -75,26 +120,117 @@
 	control = p_control;
 }
 
+- (void)dealloc {
+	if (reader != nullptr) {
+		memdelete(reader);
+	}
+}
+
+- (void)beginStream:(NSString *)p_url {
+	[self abortStream];
+	stream_url = p_url;
+}
+
+- (BOOL)canWriteStream {
+	return (stream_task != nil); // Not requested by the view yet.
+}
+
+- (void)writeStream:(const CharString &)p_chunk {
+	[stream_task didReceiveData:[NSData dataWithBytes:(const void *)p_chunk.get_data() length:(NSUInteger)p_chunk.length()]];
+}
+
+- (void)endStream {
+	// Chunks are delivered to the task as they are written, the document is complete.
+	BOOL delivered = (stream_task != nil);
+	[stream_task didFinish];
+	stream_task = nil;
+	stream_url = nil;
+	if (delivered) {
+		control->_document_stream_done();
+	} else {
+		control->_document_stream_closed();
+	}
+}
+
+- (void)abortStream {
+	if (stream_task != nil) {
+		[stream_task didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+	}
+	stream_task = nil;
+	stream_url = nil;
+}
+
+- (void)answerBinaryTask:(id<WKURLSchemeTask>)urlSchemeTask {
+	// Body is copied once, to the payload passed to the signal.
+	PoolByteArray body;
+	NSURLRequest *request = urlSchemeTask.request;
+	if (request.HTTPBody != nil) {
+		body.resize((int)MIN((NSUInteger)WebViewOverlay::MAX_BINARY_TRANSFER_SIZE + 1, request.HTTPBody.length));
+		PoolByteArray::Write w = body.write();
+		memcpy(w.ptr(), request.HTTPBody.bytes, body.size());
+	} else if (request.HTTPBodyStream != nil) {
+		NSInputStream *stream = request.HTTPBodyStream;
+		[stream open];
+		int size = 0;
+		while (size <= WebViewOverlay::MAX_BINARY_TRANSFER_SIZE) { // Larger body is refused.
+			body.resize(size + WebViewResourceReader::CHUNK_SIZE);
+			NSInteger len;
+			{
+				PoolByteArray::Write w = body.write();
+				len = [stream read:w.ptr() + size maxLength:WebViewResourceReader::CHUNK_SIZE];
+			}
+			if (len <= 0) {
+				break;
+			}
+			size += len;
+		}
+		[stream close];
+		body.resize(size);
+	}
+
+	PoolByteArray response;
+	String path = String::utf8([request.URL.path UTF8String]).trim_prefix("/");
+	int status = WebViewOverlay::_binary_request(path, body, response);
+
+	NSDictionary *headers = @{ @"Access-Control-Allow-Origin" : @"*", @"Content-Type" : @"application/octet-stream", @"Content-Length" : [NSString stringWithFormat:@"%d", response.size()] };
+	[urlSchemeTask didReceiveResponse:[[NSHTTPURLResponse alloc] initWithURL:request.URL statusCode:status HTTPVersion:@"HTTP/1.1" headerFields:headers]];
+	PoolByteArray::Read r = response.read();
+	for (int pos = 0; pos < response.size(); pos += WebViewResourceReader::CHUNK_SIZE) {
+		int len = MIN(response.size() - pos, (int)WebViewResourceReader::CHUNK_SIZE);
+		[urlSchemeTask didReceiveData:[NSData dataWithBytes:(const void *)(r.ptr() + pos) length:(NSUInteger)len]];
+	}
+	[urlSchemeTask didFinish];
+}
+
 - (void)webView:(WKWebView *)webView startURLSchemeTask:(id<WKURLSchemeTask>)urlSchemeTask {
 	NSURL *requestURL = urlSchemeTask.request.URL;
 	NSString *ns = [requestURL absoluteString];
 	String url = String::utf8([ns UTF8String]);
 
-	if (url.begins_with("res") || url.begins_with("user")) {
-		Error err;
-		FileAccess *f = FileAccess::open(url, FileAccess::READ, &err);
-		if (err != OK) {
-			[urlSchemeTask didReceiveResponse:[[NSHTTPURLResponse alloc] initWithURL:requestURL statusCode:404 HTTPVersion:@"HTTP/1.1" headerFields:nil]];
-			[urlSchemeTask didFinish];
-		} else {
-			PoolVector<uint8_t> data;
-			data.resize(f->get_len());
-			f->get_buffer(data.write().ptr(), f->get_len());
+	if ([requestURL.scheme isEqualToString:@"webview-bin"]) {
+		[self answerBinaryTask:urlSchemeTask];
+		return;
+	}
+
+	if ((stream_url != nil) && (stream_task == nil) && [ns isEqualToString:stream_url]) {
+		stream_task = urlSchemeTask;
+		[urlSchemeTask didReceiveResponse:[[NSURLResponse alloc] initWithURL:requestURL MIMEType:@"text/html" expectedContentLength:-1 textEncodingName:@"utf-8"]];
+		return;
+	}
 
-			[urlSchemeTask didReceiveResponse:[[NSURLResponse alloc] initWithURL:requestURL MIMEType:@"text/html" expectedContentLength:(NSInteger)data.size() textEncodingName:nil]];
-			[urlSchemeTask didReceiveData:[[NSData alloc] initWithBytes:(const void *)data.read().ptr() length:(NSUInteger)data.size()]];
-			[urlSchemeTask didFinish];
+	if (reader == nullptr) {
+		reader = memnew(WebViewResourceReader);
+	}
+	if (WebViewResourceReader::is_local_url(url) && (reader->open(url) == OK)) {
+		[urlSchemeTask didReceiveResponse:[[NSURLResponse alloc] initWithURL:requestURL MIMEType:[NSString stringWithUTF8String:reader->get_mime_type().utf8().get_data()] expectedContentLength:(NSInteger)reader->get_size() textEncodingName:nil]];
+		// Each chunk is copied once, to the data sent to the page process.
+		const uint8_t *chunk = nullptr;
+		int len = 0;
+		while ((len = reader->read_chunk(&chunk)) > 0) {
+			[urlSchemeTask didReceiveData:[NSData dataWithBytes:(const void *)chunk length:(NSUInteger)len]];
 		}
+		reader->close();
+		[urlSchemeTask didFinish];
 	} else {
 		[urlSchemeTask didReceiveResponse:[[NSHTTPURLResponse alloc] initWithURL:requestURL statusCode:404 HTTPVersion:@"HTTP/1.1" headerFields:nil]];
 		[urlSchemeTask didFinish];
@@ -102,6 +238,13 @@
 }
 
 - (void)webView:(WKWebView *)webView stopURLSchemeTask:(id<WKURLSchemeTask>)urlSchemeTask {
+	if (urlSchemeTask == stream_task) {
+		// Stopped tasks must not be used anymore.
+		stream_task = nil;
+		stream_url = nil;
+		control->_document_stream_closed();
+		return;
+	}
 	[urlSchemeTask didFinish];
 }
 
@@ -109,296 +252,326 @@
 
 /*************************************************************************/
 
-class WebViewOverlayImplementation {
+// Snapshot bitmap is copied (or drawn, if it is not in a known format) on the snapshot worker thread.
+class WebViewCGSnapshotSource : public WebViewSnapshotSource {
 public:
-	WKWebView* view = nullptr;
+	CGImageRef image = nullptr;
+	bool direct = false;
+	CFDataRef pixels = nullptr;
+	PoolVector<uint8_t> buffer;
+	PoolVector<uint8_t>::Write buffer_write;
+
+	virtual const uint8_t *lock() {
+		width = CGImageGetWidth(image);
+		height = CGImageGetHeight(image);
+
+		if (direct) {
+			pixels = CGDataProviderCopyData(CGImageGetDataProvider(image));
+			if (pixels != nullptr) {
+				stride = CGImageGetBytesPerRow(image);
+				return CFDataGetBytePtr(pixels);
+			}
+			format = WebViewPixels::FORMAT_RGBA8_PREMULTIPLIED;
+		}
+
+		// Fallback, draw to the premultiplied RGBA bitmap.
+		stride = width * 4;
+		buffer.resize(stride * height);
+		buffer_write = buffer.write();
+
+		CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+		CGContextRef context = CGBitmapContextCreate(buffer_write.ptr(), width, height, 8, stride, colorSpace, kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+		CGColorSpaceRelease(colorSpace);
+		if (context == nullptr) {
+			return nullptr;
+		}
+
+		CGContextDrawImage(context, CGRectMake(0, 0, width, height), image);
+		CGContextRelease(context);
+
+		return buffer_write.ptr();
+	}
+
+	virtual ~WebViewCGSnapshotSource() {
+		if (pixels != nullptr) {
+			CFRelease(pixels);
+		}
+		CGImageRelease(image);
+	}
 };
 
 /*************************************************************************/
 
-WebViewOverlay::WebViewOverlay() {
-	data = memnew(WebViewOverlayImplementation());
-}
-
-WebViewOverlay::~WebViewOverlay() {
-	memdelete(data);
-}
+class WebViewOverlayWK : public WebViewOverlayImplementation {
+public:
+	WKWebView* view = nullptr;
+	WKUserScript *bridge_script = nil;
+	GDWKURLSchemeHandler *scheme_handler = nil;
 
-void WebViewOverlay::_notification(int p_what) {
-	switch (p_what) {
-		case NOTIFICATION_ENTER_TREE: {
-			if (!Engine::get_singleton()->is_editor_hint() && (err_status == 0)) {
-				set_process_internal(true); // Wait for window to init, do not init in editor.
-			}
-		} break;
-		case NOTIFICATION_INTERNAL_PROCESS: {
-			if (!Engine::get_singleton()->is_editor_hint() && (data->view == nullptr) && (err_status == 0)) {
+	virtual Error create() {
 #if defined(OSX_ENABLED)
-				NSView *main_view = [[[NSApplication sharedApplication] mainWindow] contentView];
+		NSView *main_view = [[[NSApplication sharedApplication] mainWindow] contentView];
 #elif defined(IPHONE_ENABLED)
-				UIView *main_view = AppDelegate.viewController.godotView;
+		UIView *main_view = AppDelegate.viewController.godotView;
 #else
-				#error Unsupported platform!
+		#error Unsupported platform!
 #endif
-				if (main_view != nullptr) {
-					GDWKURLSchemeHandler *sch_handle = [[GDWKURLSchemeHandler alloc] init];
-					[sch_handle setControl:this];
-
-					GDWKNavigationDelegate *nav_handle = [[GDWKNavigationDelegate alloc] init];
-					[nav_handle setControl:this];
-
-					WKWebViewConfiguration* webViewConfig = [[WKWebViewConfiguration alloc] init];
-					[webViewConfig setURLSchemeHandler:sch_handle forURLScheme:@"res"];
-					[webViewConfig setURLSchemeHandler:sch_handle forURLScheme:@"user"];
-					[[webViewConfig userContentController] addScriptMessageHandler:nav_handle name:@"callback"];
-
-					WKUserScript *scr = [[WKUserScript alloc] initWithSource:(NSString *)@"function webviewMessage(s){window.webkit.messageHandlers.callback.postMessage(s);}" injectionTime:WKUserScriptInjectionTimeAtDocumentStart forMainFrameOnly:true];
-					[[webViewConfig userContentController] addUserScript:scr];
-
-					float sc = OS::get_singleton()->get_screen_max_scale();
-					Rect2i rect = get_window_rect();
-					float wh = OS::get_singleton()->get_window_size().y / sc;
-					WKWebView* m_webView = [[WKWebView alloc] initWithFrame:CGRectMake(rect.position.x / sc, wh - rect.position.y / sc - rect.size.height / sc, rect.size.width / sc, rect.size.height / sc) configuration:webViewConfig];
-
-					[m_webView setNavigationDelegate:nav_handle];
-					[m_webView setUIDelegate:nav_handle];
-					if (user_agent.length() > 0) {
-						[m_webView setCustomUserAgent:[NSString stringWithUTF8String:user_agent.utf8().get_data()]];
-					} else {
-						[m_webView setCustomUserAgent:nil];
-					}
-					[m_webView setValue:((no_background) ? @(NO) : @(YES)) forKey:@"drawsBackground"];
-					[m_webView setPageZoom:zoom];
+		if (main_view == nullptr) {
+			return ERR_UNAVAILABLE;
+		}
 
-					[m_webView setHidden:!is_visible_in_tree()];
-					[main_view addSubview:m_webView];
-					[m_webView loadRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:[NSString stringWithUTF8String:home_url.utf8().get_data()]]]];
+		GDWKURLSchemeHandler *sch_handle = [[GDWKURLSchemeHandler alloc] init];
+		[sch_handle setControl:control];
 
-					data->view = m_webView;
-					ctrl_err_status = 0;
+		GDWKNavigationDelegate *nav_handle = [[GDWKNavigationDelegate alloc] init];
+		[nav_handle setControl:control];
 
-					set_process_internal(false);
-				}
-			}
-		} break;
-		case NOTIFICATION_DRAW: {
-			if (err_status != 0) {
-				switch (err_status) {
-					case -1: {
-						_draw_error("WebView interface not initialized.");
-					} break;
-					default: {
-						_draw_error("Unknown error.");
-					} break;
-				};
-			} else if (ctrl_err_status > 0) {
-				_draw_error("Unknown control error.");
-			} else if (Engine::get_singleton()->is_editor_hint()) {
-				_draw_placeholder();
-			}
-		} FALLTHROUGH;
-		case NOTIFICATION_MOVED_IN_PARENT:
-		case NOTIFICATION_RESIZED: {
-			if (data->view != nullptr) {
-				float sc = OS::get_singleton()->get_screen_max_scale();
-				Rect2i rect = get_window_rect();
-				float wh = OS::get_singleton()->get_window_size().y / sc;
-				[data->view setFrame:CGRectMake(rect.position.x / sc, wh - rect.position.y / sc - rect.size.height / sc, rect.size.width / sc, rect.size.height / sc)];
-			}
-		} break;
-		case NOTIFICATION_VISIBILITY_CHANGED: {
-			if (data->view != nullptr) {
-				[data->view setHidden:!is_visible_in_tree()];
-			}
-		} break;
-		case NOTIFICATION_EXIT_TREE: {
-			
-			if (data->view != nullptr) {
-				[data->view removeFromSuperview];
-				data->view = nullptr;
-			}
-		} break;
-		default: {
-			//NOP
-		} break;
-	}
-}
+		WKWebViewConfiguration* webViewConfig = [[WKWebViewConfiguration alloc] init];
+		[webViewConfig setURLSchemeHandler:sch_handle forURLScheme:@"res"];
+		[webViewConfig setURLSchemeHandler:sch_handle forURLScheme:@"user"];
+		[webViewConfig setURLSchemeHandler:sch_handle forURLScheme:@"webview-bin"];
+		scheme_handler = sch_handle;
+		[[webViewConfig userContentController] addScriptMessageHandler:nav_handle name:@"callback"];
 
-void WebViewOverlay::get_snapshot(int p_width) {
-	
-	WKSnapshotConfiguration *wkSnapshotConfig = [[WKSnapshotConfiguration alloc] init];
-	wkSnapshotConfig.snapshotWidth = [NSNumber numberWithInt:p_width];
-	wkSnapshotConfig.afterScreenUpdates = NO;
+		String bridge = "function webviewMessage(s){window.webkit.messageHandlers.callback.postMessage(s);}" + control->_get_binary_endpoint_script() + WebViewOverlay::get_bridge_script();
+		bridge_script = [[WKUserScript alloc] initWithSource:[NSString stringWithUTF8String:bridge.utf8().get_data()] injectionTime:WKUserScriptInjectionTimeAtDocumentStart forMainFrameOnly:true];
+		[[webViewConfig userContentController] addUserScript:bridge_script];
 
+		WKWebView* m_webView = [[WKWebView alloc] initWithFrame:CGRectMake(0, 0, 0, 0) configuration:webViewConfig];
 
-	[data->view takeSnapshotWithConfiguration:wkSnapshotConfig
-#if defined(OSX_ENABLED)
-		completionHandler:^(NSImage * _Nullable image, NSError * _Nullable error) {
-#elif defined(IPHONE_ENABLED)
-		completionHandler:^(UIImage * _Nullable image, NSError * _Nullable error) {
-#else
-		#error Unsupported platform!
-#endif
-		if (image != nullptr) {
-			CGImageRef imageRef = [image CGImage];
-			NSUInteger width = CGImageGetWidth(imageRef);
-			NSUInteger height = CGImageGetHeight(imageRef);
-
-			PoolVector<uint8_t> imgdata;
-			imgdata.resize(width * height * 4);
-			PoolVector<uint8_t>::Write wr = imgdata.write();
-
-			NSUInteger bytesPerPixel = 4;
-			NSUInteger bytesPerRow = bytesPerPixel * width;
-			NSUInteger bitsPerComponent = 8;
-			CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-			CGContextRef context = CGBitmapContextCreate(wr.ptr(), width, height, bitsPerComponent, bytesPerRow, colorSpace, kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
-			CGColorSpaceRelease(colorSpace);
-
-			CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
-			CGContextRelease(context);
-
-			emit_signal("snapshot_ready", memnew(Image(width, height, false, Image::FORMAT_RGBA8, imgdata)));
+		[m_webView setNavigationDelegate:nav_handle];
+		[m_webView setUIDelegate:nav_handle];
+		[main_view addSubview:m_webView];
+
+		view = m_webView;
+		return OK;
+	}
+
+	virtual void destroy() {
+		if (view != nullptr) {
+			[scheme_handler abortStream];
+			[view removeFromSuperview];
+			view = nullptr;
+			bridge_script = nil;
+			scheme_handler = nil;
 		}
-	}];
-}
+	}
 
-void WebViewOverlay::set_no_background(bool p_bg) {
-	no_background = p_bg;
-	
-	if (data->view != nullptr) {
-		[data->view setValue:((no_background) ? @(NO) : @(YES)) forKey:@"drawsBackground"];
+	virtual bool is_created() const {
+		return (view != nullptr);
 	}
-}
 
-bool WebViewOverlay::get_no_background() const {
-	return no_background;
-}
+	virtual String get_binary_endpoint() const {
+		return "webview-bin://binary/";
+	}
 
-void WebViewOverlay::set_url(const String& p_url) {
-	home_url = p_url;
-	
-	if (data->view != nullptr) {
-		[data->view loadRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:[NSString stringWithUTF8String:home_url.utf8().get_data()]]]];
+	virtual bool is_ready() const {
+		return (view != nullptr);
 	}
-}
 
-String WebViewOverlay::get_url() const {
-	if (data->view != nullptr) {
-		NSString *ns = [[data->view URL] absoluteString];
-		return String::utf8([ns UTF8String]);
+	virtual void set_bounds(const Rect2 &p_rect) {
+		// Flip to the bottom-left origin.
+		float wh = OS::get_singleton()->get_window_size().y / OS::get_singleton()->get_screen_max_scale();
+		[view setFrame:CGRectMake(p_rect.position.x, wh - p_rect.position.y - p_rect.size.height, p_rect.size.width, p_rect.size.height)];
+	}
+
+	virtual void set_visible(bool p_visible) {
+		[view setHidden:!p_visible];
+	}
+
+	virtual void set_no_background(bool p_bg) {
+		[view setValue:((p_bg) ? @(NO) : @(YES)) forKey:@"drawsBackground"];
 	}
-	return home_url;
-}
 
-void WebViewOverlay::set_user_agent(const String& p_user_agent) {
-	user_agent = p_user_agent;
-	
-	if (data->view != nullptr) {
-		if (user_agent.length() > 0) {
-			[data->view setCustomUserAgent:[NSString stringWithUTF8String:user_agent.utf8().get_data()]];
+	virtual void set_user_agent(const String &p_user_agent) {
+		if (p_user_agent.length() > 0) {
+			[view setCustomUserAgent:[NSString stringWithUTF8String:p_user_agent.utf8().get_data()]];
 		} else {
-			[data->view setCustomUserAgent:nil];
+			[view setCustomUserAgent:nil];
 		}
 	}
-}
 
-String WebViewOverlay::get_user_agent() const {
-	if (data->view != nullptr) {
-		NSString *ns = [data->view customUserAgent];
+	virtual String get_user_agent() const {
+		NSString *ns = [view customUserAgent];
 		return String::utf8([ns UTF8String]);
 	}
-	return user_agent;
-}
 
-double WebViewOverlay::get_zoom_level() const {
-	if (data->view != nullptr) {
-		return [data->view pageZoom];
+	virtual void set_zoom_level(double p_zoom) {
+		[view setPageZoom:p_zoom];
 	}
-	return zoom;
-}
 
-void WebViewOverlay::set_zoom_level(double p_zoom) {
-	zoom = p_zoom;
+	virtual double get_zoom_level() const {
+		return [view pageZoom];
+	}
 
-	if (data->view != nullptr) {
-		[data->view setPageZoom:zoom];
+	virtual void navigate(const String &p_url) {
+		[view loadRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:[NSString stringWithUTF8String:p_url.utf8().get_data()]]]];
 	}
-}
 
-String WebViewOverlay::get_title() const {
-	ERR_FAIL_COND_V(data->view == nullptr, "");
+	virtual String get_url() const {
+		NSString *ns = [[view URL] absoluteString];
+		return String::utf8([ns UTF8String]);
+	}
 
-	NSString *ns = [data->view title];
-	return String::utf8([ns UTF8String]);
-}
+	virtual String get_title() const {
+		NSString *ns = [view title];
+		return String::utf8([ns UTF8String]);
+	}
 
-void WebViewOverlay::execute_java_script(const String &p_script) {
-	ERR_FAIL_COND(data->view == nullptr);
-	[data->view evaluateJavaScript:[NSString stringWithUTF8String:p_script.utf8().get_data()] completionHandler:nil];
-}
+	virtual void load_string(const String &p_source) {
+		[view loadHTMLString:[NSString stringWithUTF8String:p_source.utf8().get_data()] baseURL:nil];
+	}
 
-void WebViewOverlay::load_string(const String &p_source) {
-	ERR_FAIL_COND(data->view == nullptr);
-	[data->view loadHTMLString:[NSString stringWithUTF8String:p_source.utf8().get_data()] baseURL:nil];
-}
+	virtual void exec_script(const String &p_script) {
+		[view evaluateJavaScript:[NSString stringWithUTF8String:p_script.utf8().get_data()] completionHandler:nil];
+	}
 
-bool WebViewOverlay::can_go_back() const {
-	ERR_FAIL_COND_V(data->view == nullptr, false);
+	virtual void set_document_start_script(const String &p_source) {
+		// User scripts can't be removed individually, bridge is added again.
+		WKUserContentController *ucc = [[view configuration] userContentController];
+		[ucc removeAllUserScripts];
+		[ucc addUserScript:bridge_script];
+		if (!p_source.empty()) {
+			WKUserScript *scr = [[WKUserScript alloc] initWithSource:[NSString stringWithUTF8String:p_source.utf8().get_data()] injectionTime:WKUserScriptInjectionTimeAtDocumentStart forMainFrameOnly:true];
+			[ucc addUserScript:scr];
+		}
+	}
 
-	return [data->view canGoBack];
-}
+	virtual void document_stream_begin(const String &p_url) {
+		NSString *url = [NSString stringWithUTF8String:p_url.utf8().get_data()];
+		[scheme_handler beginStream:url];
+		[view loadRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:url]]];
+	}
 
-bool WebViewOverlay::can_go_forward() const {
-	ERR_FAIL_COND_V(data->view == nullptr, false);
+	virtual bool document_stream_can_write() {
+		return [scheme_handler canWriteStream];
+	}
 
-	return [data->view canGoForward];
-}
+	virtual void document_stream_write(const CharString &p_chunk) {
+		[scheme_handler writeStream:p_chunk];
+	}
 
-bool WebViewOverlay::is_ready() const {
-	return (data->view != nullptr);
-}
+	virtual void document_stream_end() {
+		[scheme_handler endStream];
+	}
 
-bool WebViewOverlay::is_loading() const {
-	ERR_FAIL_COND_V(data->view == nullptr, false);
+	virtual void document_stream_abort() {
+		[scheme_handler abortStream];
+	}
 
-	return [data->view isLoading];
-}
+	virtual void evaluate_script(const String &p_script, uint64_t p_id) {
+		// Control is resolved when the result arrives, it can be freed while the script is running.
+		ObjectID ctrl_id = control->get_instance_id();
+		[view evaluateJavaScript:[NSString stringWithUTF8String:p_script.utf8().get_data()]
+				completionHandler:^(id _Nullable result, NSError *_Nullable error) {
+					WebViewOverlay *ctrl = Object::cast_to<WebViewOverlay>(ObjectDB::get_instance(ctrl_id));
+					if (!ctrl) {
+						return;
+					}
+					if (error != nil) {
+						ctrl->_script_failed(p_id, String::utf8([[error localizedDescription] UTF8String]));
+					} else {
+						ctrl->_script_evaluated(p_id, _variant_from_ns(result));
+					}
+				}];
+	}
 
-bool WebViewOverlay::is_secure_content() const {
-	ERR_FAIL_COND_V(data->view == nullptr, false);
+	virtual void capture(int p_width, uint64_t p_id) {
+		WKSnapshotConfiguration *wkSnapshotConfig = [[WKSnapshotConfiguration alloc] init];
+		wkSnapshotConfig.snapshotWidth = [NSNumber numberWithInt:p_width];
+		wkSnapshotConfig.afterScreenUpdates = NO;
 
-	return [data->view hasOnlySecureContent];
-}
+		WebViewOverlay *ctrl = control;
+		[view takeSnapshotWithConfiguration:wkSnapshotConfig
+#if defined(OSX_ENABLED)
+			completionHandler:^(NSImage * _Nullable image, NSError * _Nullable error) {
+#elif defined(IPHONE_ENABLED)
+			completionHandler:^(UIImage * _Nullable image, NSError * _Nullable error) {
+#else
+			#error Unsupported platform!
+#endif
+			if (image != nullptr) {
+				CGImageRef imageRef = [image CGImage];
+
+				// Use snapshot pixels directly if they are in a known 8-bit format.
+				CGImageAlphaInfo alpha = CGImageGetAlphaInfo(imageRef);
+				CGBitmapInfo order = CGImageGetBitmapInfo(imageRef) & kCGBitmapByteOrderMask;
+				bool direct = (CGImageGetBitsPerPixel(imageRef) == 32) && (CGImageGetBitsPerComponent(imageRef) == 8);
+				WebViewPixels::Format format = WebViewPixels::FORMAT_RGBA8;
+				if (direct && (order == kCGBitmapByteOrder32Little) && (alpha == kCGImageAlphaPremultipliedFirst)) {
+					format = WebViewPixels::FORMAT_BGRA8_PREMULTIPLIED;
+				} else if (direct && (order == kCGBitmapByteOrder32Little) && (alpha == kCGImageAlphaFirst)) {
+					format = WebViewPixels::FORMAT_BGRA8;
+				} else if (direct && (order == kCGBitmapByteOrder32Little) && (alpha == kCGImageAlphaNoneSkipFirst)) {
+					format = WebViewPixels::FORMAT_BGRX8;
+				} else if (direct && ((order == kCGBitmapByteOrder32Big) || (order == kCGBitmapByteOrderDefault)) && (alpha == kCGImageAlphaPremultipliedLast)) {
+					format = WebViewPixels::FORMAT_RGBA8_PREMULTIPLIED;
+				} else if (direct && ((order == kCGBitmapByteOrder32Big) || (order == kCGBitmapByteOrderDefault)) && (alpha == kCGImageAlphaLast)) {
+					format = WebViewPixels::FORMAT_RGBA8;
+				} else if (direct && ((order == kCGBitmapByteOrder32Big) || (order == kCGBitmapByteOrderDefault)) && (alpha == kCGImageAlphaNoneSkipLast)) {
+					format = WebViewPixels::FORMAT_RGBX8;
+				} else {
+					direct = false;
+				}
 
-void WebViewOverlay::go_back() {
-	ERR_FAIL_COND(data->view == nullptr);
+				WebViewCGSnapshotSource *source = memnew(WebViewCGSnapshotSource);
+				source->image = CGImageRetain(imageRef);
+				source->direct = direct;
+				source->format = (direct) ? format : WebViewPixels::FORMAT_RGBA8_PREMULTIPLIED;
+				ctrl->_snapshot_ready_source(p_id, source);
+			} else {
+				ctrl->_snapshot_failed(p_id);
+			}
+		}];
+	}
 
-	[data->view goBack];
-}
+	virtual bool can_go_back() const {
+		return [view canGoBack];
+	}
+
+	virtual bool can_go_forward() const {
+		return [view canGoForward];
+	}
 
-void WebViewOverlay::go_forward() {
-	ERR_FAIL_COND(data->view == nullptr);
+	virtual bool is_loading() const {
+		return [view isLoading];
+	}
 
-	[data->view goForward];
-}
+	virtual bool is_secure_content() const {
+		return [view hasOnlySecureContent];
+	}
 
-void WebViewOverlay::reload() {
-	ERR_FAIL_COND(data->view == nullptr);
+	virtual void go_back() {
+		[view goBack];
+	}
 
-	[data->view reload];
-}
+	virtual void go_forward() {
+		[view goForward];
+	}
 
-void WebViewOverlay::stop() {
-	ERR_FAIL_COND(data->view == nullptr);
+	virtual void reload() {
+		[view reload];
+	}
 
-	[data->view stopLoading];
-}
+	virtual void stop() {
+		[view stopLoading];
+	}
+};
 
-void WebViewOverlay::init() {
-	err_status = 0;
+/*************************************************************************/
+
+int WebViewOverlayImplementation::init_native() {
+	return 0;
 }
 
-void WebViewOverlay::finish() {
+void WebViewOverlayImplementation::finish_native() {
 	//NOP
-}
\ No newline at end of file
+}
+
+String WebViewOverlayImplementation::get_native_error(int p_status) {
+	return "Unknown error.";
+}
+
+WebViewOverlayImplementation *WebViewOverlayImplementation::create_native() {
+	return memnew(WebViewOverlayWK());
+}